@@ -0,0 +1,434 @@
+/**
+ * @file Benchmark.cpp
+ * @author Adam Lonstein (adam.lonstein@digipen.com)
+ * @brief A benchmark driver for the open-addressing hash table. Measures insert, find (hits and
+ *        misses) and remove for a sweep of collision/deletion policies, max load factors, growth
+ *        factors, table sizes and key distributions. Each operation reports its mean time,
+ *        latency percentiles (from every SAMPLE_EVERY-th operation, timed on its own) and the
+ *        probes it took from OAHTStats. A sampled operation doesn't overlap its cache misses
+ *        with the next one, so for large tables the median can be above the mean.
+ *
+ *        Build: g++ -std=c++11 -O2 -DNDEBUG Benchmark.cpp Support.cpp -o Benchmark
+ *        Run:   ./Benchmark [--sizes 1000,100000,4000000] [--load 0.5,0.7,0.9] [--growth 2]
+ *                           [--policy linear-mark,...] [--dist uniform,zipfian,prefix]
+ * @date 10-14-2026
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "OAHashTable.h"
+
+namespace
+{
+typedef OAHashTable<unsigned> BenchTable;
+typedef std::chrono::steady_clock Clock;
+
+//! Every SAMPLE_EVERY-th operation is timed on its own for the percentiles
+const unsigned SAMPLE_EVERY = 16;
+
+//! Zipfian skew (the YCSB default)
+const double ZIPF_THETA = 0.99;
+
+//! A collision and deletion policy to measure
+struct BenchPolicy
+{
+    const char* Name;               //!< Name on the command line and in the report
+    bool DoubleHashing;             //!< Stride from the full hash (vs. linear probing)
+    OAHTDeletionPolicy Deletion;    //!< MARK, PACK or BACKWARD_SHIFT
+    OAHTLayoutPolicy Layout;        //!< SLOT_STATE or CONTROL_BYTES
+    OAHTCollisionPolicy Collision;  //!< PROBE_SEQUENCE, ROBIN_HOOD or CUCKOO
+    OAHTSizingPolicy Sizing;        //!< PRIME_SIZES or POWER_OF_TWO_SIZES
+};
+
+// Double hashing isn't paired with PACK: packing walks the linear cluster after the removed
+// slot, which isn't where double-hashed keys that probed through it are
+const BenchPolicy POLICIES[] =
+{
+    {"linear-mark",     false, MARK,           SLOT_STATE,    PROBE_SEQUENCE, PRIME_SIZES},
+    {"linear-pack",     false, PACK,           SLOT_STATE,    PROBE_SEQUENCE, PRIME_SIZES},
+    {"double-mark",     true,  MARK,           SLOT_STATE,    PROBE_SEQUENCE, PRIME_SIZES},
+    {"group-mark",      false, MARK,           CONTROL_BYTES, PROBE_SEQUENCE, POWER_OF_TWO_SIZES},
+    {"robinhood-shift", false, BACKWARD_SHIFT, SLOT_STATE,    ROBIN_HOOD,     PRIME_SIZES},
+    {"cuckoo",          false, MARK,           SLOT_STATE,    CUCKOO,         PRIME_SIZES},
+};
+
+//! How keys look and which keys are looked up
+enum BenchDistribution
+{
+    UNIFORM, //!< Scrambled numbers, looked up uniformly
+    ZIPFIAN, //!< The same keys, hits looked up with a Zipfian skew
+    PREFIX   //!< Long keys sharing a prefix, looked up uniformly
+};
+
+const char* const DISTRIBUTIONS[] = {"uniform", "zipfian", "prefix"};
+
+//! The report of one operation of one run
+struct BenchResult
+{
+    double MeanNs;    //!< Mean time of an operation
+    double P50Ns;     //!< Median of the sampled operations
+    double P99Ns;     //!< 99th percentile
+    double P999Ns;    //!< 99.9th percentile
+    double Probes;    //!< Probes per operation
+};
+
+/**
+ * @brief A small fast random number generator (xorshift64*), so runs are repeatable
+ */
+class BenchRandom
+{
+  public:
+    explicit BenchRandom(unsigned long long Seed) : mState(Seed ? Seed : 1) {}
+
+    unsigned long long Next()
+    {
+        mState ^= mState >> 12;
+        mState ^= mState << 25;
+        mState ^= mState >> 27;
+        return mState * 2685821657736338717ull;
+    }
+
+    //! Uniform in [0, 1)
+    double NextDouble() { return static_cast<double>(Next() >> 11) / 9007199254740992.0; }
+
+    //! Uniform in [0, Count)
+    unsigned NextBelow(unsigned Count) { return static_cast<unsigned>(Next() % Count); }
+
+  private:
+    unsigned long long mState;
+};
+
+/**
+ * @brief Draws ranks from a Zipfian distribution over [0, Count) (Gray et al., as in YCSB)
+ */
+class BenchZipf
+{
+  public:
+    BenchZipf(unsigned Count, double Theta) : mCount(Count)
+    {
+        double zeta2 = 1 + std::pow(0.5, Theta);
+
+        mZetaN = 0;
+        for (unsigned i = 1; i <= Count; ++i)
+            mZetaN += 1 / std::pow(static_cast<double>(i), Theta);
+
+        mAlpha = 1 / (1 - Theta);
+        mEta = (1 - std::pow(2.0 / Count, 1 - Theta)) / (1 - zeta2 / mZetaN);
+        mHalfPow = std::pow(0.5, Theta);
+    }
+
+    unsigned Next(BenchRandom& Random) const
+    {
+        double u = Random.NextDouble();
+        double uz = u * mZetaN;
+
+        if (uz < 1)
+            return 0;
+        if (uz < 1 + mHalfPow)
+            return mCount > 1 ? 1 : 0;
+
+        unsigned rank = static_cast<unsigned>(mCount * std::pow(mEta * u - mEta + 1, mAlpha));
+        return rank < mCount ? rank : mCount - 1;
+    }
+
+  private:
+    unsigned mCount;
+    double mZetaN;
+    double mAlpha;
+    double mEta;
+    double mHalfPow;
+};
+
+/**
+ * @brief Makes Count keys to insert followed by Count keys that are never inserted, each in a
+ *        record of MAX_KEYLEN bytes
+ */
+std::vector<char> MakeKeys(unsigned Count, BenchDistribution Distribution)
+{
+    std::vector<char> keys(static_cast<size_t>(Count) * 2 * MAX_KEYLEN);
+
+    for (unsigned i = 0; i < 2 * Count; ++i)
+    {
+        char* key = &keys[static_cast<size_t>(i) * MAX_KEYLEN];
+
+        // An odd multiplier scrambles the numbers without repeating any
+        if (Distribution == PREFIX)
+            std::snprintf(key, MAX_KEYLEN, "tenant/0042/session/%010u", i);
+        else
+            std::snprintf(key, MAX_KEYLEN, "%u", i * 2654435761u);
+    }
+
+    return keys;
+}
+
+/**
+ * @brief Takes a percentile of sorted latencies
+ */
+double Percentile(const std::vector<double>& Sorted, double Fraction)
+{
+    if (Sorted.empty())
+        return 0;
+
+    size_t index = static_cast<size_t>(Fraction * (Sorted.size() - 1) + 0.5);
+    return Sorted[index];
+}
+
+/**
+ * @brief The cost of reading the clock, taken off the sampled latencies
+ */
+double ClockOverheadNs()
+{
+    double best = 1e9;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        Clock::time_point a = Clock::now();
+        Clock::time_point b = Clock::now();
+        double ns = std::chrono::duration<double, std::nano>(b - a).count();
+
+        if (ns < best)
+            best = ns;
+    }
+
+    return best;
+}
+
+/**
+ * @brief Runs an operation over a list of key indices, timing the whole list for the mean and
+ *        every SAMPLE_EVERY-th operation on its own for the percentiles
+ *
+ * @param Table - the table (for the probe count)
+ * @param Order - the key indices, in the order they're used
+ * @param Op - called as Op(index)
+ * @param Overhead - the clock overhead
+ * @return BenchResult - the report
+ */
+template <typename Operation>
+BenchResult Measure(const BenchTable& Table, const std::vector<unsigned>& Order, Operation Op, double Overhead)
+{
+    std::vector<double> samples;
+    samples.reserve(Order.size() / SAMPLE_EVERY + 1);
+
+    unsigned probes = Table.GetStats().Probes_;
+    Clock::time_point start = Clock::now();
+
+    for (size_t i = 0; i < Order.size(); ++i)
+    {
+        if (i % SAMPLE_EVERY)
+        {
+            Op(Order[i]);
+            continue;
+        }
+
+        Clock::time_point a = Clock::now();
+        Op(Order[i]);
+        Clock::time_point b = Clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(b - a).count() - Overhead;
+        samples.push_back(ns > 0 ? ns : 0);
+    }
+
+    double total = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.MeanNs = Order.empty() ? 0 : total / Order.size();
+    result.P50Ns = Percentile(samples, 0.5);
+    result.P99Ns = Percentile(samples, 0.99);
+    result.P999Ns = Percentile(samples, 0.999);
+    result.Probes = Order.empty() ? 0 : static_cast<double>(Table.GetStats().Probes_ - probes) / Order.size();
+
+    return result;
+}
+
+/**
+ * @brief Prints one line of the report
+ */
+void Report(const BenchPolicy& Policy, BenchDistribution Distribution, unsigned Count, double Load, double Growth,
+            const char* Op, const BenchResult& Result, const OAHTStats& Stats)
+{
+    std::printf("%-16s %-8s %10u %5.2f %5.2f  %-7s %8.1f %8.1f %8.1f %8.1f %8.2f %10u %4u\n",
+                Policy.Name, DISTRIBUTIONS[Distribution], Count, Load, Growth, Op,
+                Result.MeanNs, Result.P50Ns, Result.P99Ns, Result.P999Ns, Result.Probes, Stats.TableSize_, Stats.Expansions_);
+}
+
+/**
+ * @brief Fills a table with Count keys, then finds every key (hits), finds as many keys that
+ *        aren't there (misses) and removes every key, reporting each
+ */
+void Run(const BenchPolicy& Policy, BenchDistribution Distribution, unsigned Count, double Load, double Growth,
+         const std::vector<char>& Keys, double Overhead)
+{
+    BenchTable::OAHTConfig config(11, HashKey, Policy.DoubleHashing, Load, Growth, Policy.Deletion);
+    config.LayoutPolicy_ = Policy.Layout;
+    config.CollisionPolicy_ = Policy.Collision;
+    config.SizingPolicy_ = Policy.Sizing;
+
+    BenchTable table(config);
+    BenchRandom random(Count * 31 + Distribution);
+
+    // Inserts and removes go through the keys in a random order
+    std::vector<unsigned> shuffled(Count);
+    for (unsigned i = 0; i < Count; ++i)
+        shuffled[i] = i;
+    for (unsigned i = Count; i > 1; --i)
+        std::swap(shuffled[i - 1], shuffled[random.NextBelow(i)]);
+
+    // Hits follow the distribution (the Zipfian ranks are scrambled over the keys), misses use
+    // the keys after the inserted ones
+    std::vector<unsigned> hits(Count), misses(Count);
+    if (Distribution == ZIPFIAN)
+    {
+        BenchZipf zipf(Count, ZIPF_THETA);
+
+        for (unsigned i = 0; i < Count; ++i)
+            hits[i] = shuffled[zipf.Next(random)];
+    }
+    else
+    {
+        for (unsigned i = 0; i < Count; ++i)
+            hits[i] = random.NextBelow(Count);
+    }
+
+    for (unsigned i = 0; i < Count; ++i)
+        misses[i] = Count + random.NextBelow(Count);
+
+    const char* keys = &Keys[0];
+    unsigned found = 0;
+
+    try
+    {
+        BenchResult insert = Measure(table, shuffled, [&](unsigned i) { table.insert(keys + static_cast<size_t>(i) * MAX_KEYLEN, i); }, Overhead);
+        OAHTStats full = table.GetStats();
+
+        BenchResult hit = Measure(table, hits, [&](unsigned i) { found += table.try_find(keys + static_cast<size_t>(i) * MAX_KEYLEN) != 0; }, Overhead);
+        BenchResult miss = Measure(table, misses, [&](unsigned i) { found += table.try_find(keys + static_cast<size_t>(i) * MAX_KEYLEN) != 0; }, Overhead);
+        BenchResult remove = Measure(table, shuffled, [&](unsigned i) { table.remove(keys + static_cast<size_t>(i) * MAX_KEYLEN); }, Overhead);
+
+        Report(Policy, Distribution, Count, Load, Growth, "insert", insert, full);
+        Report(Policy, Distribution, Count, Load, Growth, "hit", hit, full);
+        Report(Policy, Distribution, Count, Load, Growth, "miss", miss, full);
+        Report(Policy, Distribution, Count, Load, Growth, "remove", remove, full);
+    }
+    catch (const OAHashTableException& e)
+    {
+        std::printf("%-16s %-8s %10u %5.2f %5.2f  failed: %s\n", Policy.Name, DISTRIBUTIONS[Distribution], Count, Load, Growth, e.what());
+        return;
+    }
+
+    // Every hit must have been found and no miss (this also keeps the lookups from being optimized away)
+    if (found != Count)
+        std::printf("%-16s %-8s %10u %5.2f %5.2f  failed: %u of %u lookups found\n", Policy.Name, DISTRIBUTIONS[Distribution], Count, Load, Growth, found, Count);
+}
+
+/**
+ * @brief Splits a comma-separated list
+ */
+std::vector<std::string> SplitList(const char* List)
+{
+    std::vector<std::string> items;
+    std::string item;
+
+    for (const char* c = List; ; ++c)
+    {
+        if (*c == ',' || *c == 0)
+        {
+            if (!item.empty())
+                items.push_back(item);
+            item.clear();
+
+            if (*c == 0)
+                break;
+        }
+        else
+            item += *c;
+    }
+
+    return items;
+}
+
+/**
+ * @brief Whether a name was picked by a list (an empty list picks everything)
+ */
+bool Picked(const std::vector<std::string>& List, const char* Name)
+{
+    return List.empty() || std::find(List.begin(), List.end(), Name) != List.end();
+}
+}
+
+/**
+ * @brief Parses the sweep from the command line and runs every combination of it
+ */
+int main(int argc, char** argv)
+{
+    std::vector<std::string> sizes = SplitList("1000,100000,4000000");
+    std::vector<std::string> loads = SplitList("0.5,0.7,0.9");
+    std::vector<std::string> growths = SplitList("2");
+    std::vector<std::string> policies, distributions;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!std::strcmp(argv[i], "--sizes"))
+            sizes = SplitList(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--load"))
+            loads = SplitList(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--growth"))
+            growths = SplitList(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--policy"))
+            policies = SplitList(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--dist"))
+            distributions = SplitList(argv[i + 1]);
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--sizes N,...] [--load LF,...] [--growth G,...] [--policy NAME,...] [--dist NAME,...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    double overhead = ClockOverheadNs();
+
+    std::printf("%-16s %-8s %10s %5s %5s  %-7s %8s %8s %8s %8s %8s %10s %4s\n",
+                "policy", "dist", "keys", "load", "grow", "op", "ns/op", "p50", "p99", "p99.9", "probes", "slots", "exp");
+
+    for (size_t s = 0; s < sizes.size(); ++s)
+    {
+        unsigned count = static_cast<unsigned>(std::strtoul(sizes[s].c_str(), 0, 10));
+        if (count == 0)
+            continue;
+
+        for (int d = UNIFORM; d <= PREFIX; ++d)
+        {
+            if (!Picked(distributions, DISTRIBUTIONS[d]))
+                continue;
+
+            // The keys are made once for every run of this size and distribution
+            std::vector<char> keys = MakeKeys(count, static_cast<BenchDistribution>(d));
+
+            for (size_t p = 0; p < sizeof(POLICIES) / sizeof(POLICIES[0]); ++p)
+            {
+                if (!Picked(policies, POLICIES[p].Name))
+                    continue;
+
+                for (size_t l = 0; l < loads.size(); ++l)
+                {
+                    for (size_t g = 0; g < growths.size(); ++g)
+                    {
+                        Run(POLICIES[p], static_cast<BenchDistribution>(d), count, std::atof(loads[l].c_str()),
+                            std::atof(growths[g].c_str()), keys, overhead);
+                        std::fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,599 @@
+/**
+ * @file ConcurrentOAHashTable.cpp
+ * @author Adam Lonstein (adam.lonstein@digipen.com)
+ * @brief A read-mostly concurrent version of the open-addressing hash table. Any number of threads
+ *        can call find() while one thread at a time inserts or removes (writers are serialized with
+ *        a lock). Readers never block and never write shared memory. A reader copies the data out
+ *        while it is protected by its epoch, and removed elements and old tables are freed once no
+ *        reader can still see them.
+ * @date 10-14-2026
+ */
+
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief Returns the process-wide epoch domain
+ */
+inline OAHTEpochDomain& OAHTEpochDomain::Global()
+{
+    static OAHTEpochDomain domain;
+
+    return domain;
+}
+
+/**
+ * @brief Advances the global epoch. Called after an object is unlinked.
+ *
+ * @return unsigned long long - the epoch to stamp the retired object with
+ */
+inline unsigned long long OAHTEpochDomain::Retire()
+{
+    // Unlinking must be visible before any reader record is looked at
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    return mEpoch.fetch_add(1, std::memory_order_seq_cst);
+}
+
+/**
+ * @brief Finds the oldest epoch any reader is in. An object retired in an earlier epoch was
+ *        unlinked before every current reader started, so it can be freed.
+ *
+ * @return unsigned long long - the oldest reader's epoch (the current epoch if there are no readers)
+ */
+inline unsigned long long OAHTEpochDomain::OldestReader() const
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    unsigned long long oldest = mEpoch.load(std::memory_order_seq_cst);
+
+    for (Record* record = mHead.load(std::memory_order_acquire); record; record = record->Next)
+    {
+        unsigned long long epoch = record->Epoch.load(std::memory_order_seq_cst);
+
+        if (epoch && epoch < oldest)
+            oldest = epoch;
+    }
+
+    return oldest;
+}
+
+/**
+ * @brief Returns the calling thread's record, acquiring one the first time
+ */
+inline OAHTEpochDomain::Record* OAHTEpochDomain::ThreadRecord()
+{
+    // Hands the record back when the thread exits
+    struct Owner
+    {
+      Owner() : Owned(Global().AcquireRecord()) {}
+      ~Owner()
+      {
+        Owned->Epoch.store(0, std::memory_order_release);
+        Owned->InUse.store(false, std::memory_order_release);
+      }
+
+      Record* Owned;
+    };
+
+    static thread_local Owner owner;
+
+    return owner.Owned;
+}
+
+/**
+ * @brief Claims a free record, or adds a new one to the domain
+ */
+inline OAHTEpochDomain::Record* OAHTEpochDomain::AcquireRecord()
+{
+    // Reuse a record of a thread that has exited
+    for (Record* record = mHead.load(std::memory_order_acquire); record; record = record->Next)
+    {
+        bool expected = false;
+        if (!record->InUse.load(std::memory_order_relaxed) && record->InUse.compare_exchange_strong(expected, true))
+            return record;
+    }
+
+    Record* record = new Record;
+    record->InUse.store(true, std::memory_order_relaxed);
+
+    Record* head = mHead.load(std::memory_order_relaxed);
+    do
+    {
+        record->Next = head;
+    } while (!mHead.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+
+    return record;
+}
+
+/**
+ * @brief Initializes the config, stats, and table
+ */
+template<typename T>
+ConcurrentOAHashTable<T>::ConcurrentOAHashTable(const OAHTConfig& Config) : mTable(0), mTombstones(0), mConfig(Config), mStats()
+{
+    unsigned tableSize = Config.InitialTableSize_;
+    if (mConfig.SizingPolicy_ == POWER_OF_TWO_SIZES)
+        tableSize = GetNextPowerOfTwo(tableSize);
+
+    mStats.TableSize_ = tableSize;
+
+    mStats.PrimaryHashFunc_ = mConfig.PrimaryHashFunc_;
+    mStats.SecondaryHashFunc_ = mConfig.SecondaryHashFunc_;
+    mStats.FullHashFunc_ = mConfig.FullHashFunc_;
+
+    mTable.store(AllocateTable(tableSize), std::memory_order_release);
+}
+
+/**
+ * @brief Deletes the hash table and everything waiting to be reclaimed
+ */
+template<typename T>
+ConcurrentOAHashTable<T>::~ConcurrentOAHashTable()
+{
+    OAHTNodeTable* table = mTable.load(std::memory_order_relaxed);
+
+    for (unsigned i = 0; i < table->Size; ++i)
+    {
+        OAHTNode* node = table->Slots[i].load(std::memory_order_relaxed);
+
+        if (node && node != Tombstone())
+            FreeNode(node);
+    }
+
+    FreeTable(table);
+
+    for (unsigned i = 0; i < mRetired.size(); ++i)
+    {
+        if (mRetired[i].Node)
+            FreeNode(mRetired[i].Node);
+        if (mRetired[i].Table)
+            FreeTable(mRetired[i].Table);
+    }
+}
+
+/**
+ * @brief Inserts a key/data pair. Grows (or purges tombstones from) the table first if needed.
+ *
+ * @param Key - key to insert
+ * @param Data - data to insert
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::insert(const char *Key, const T& Data)
+{
+    std::lock_guard<std::mutex> lock(mWriteLock);
+
+    Reclaim();
+
+    // Removed slots still make probe sequences longer, so they count against the load factor
+    double loadFactor = static_cast<double>(mStats.Count_ + mTombstones + 1) / static_cast<double>(mStats.TableSize_);
+
+    if (loadFactor > mConfig.MaxLoadFactor_)
+    {
+        double liveFactor = static_cast<double>(mStats.Count_ + 1) / static_cast<double>(mStats.TableSize_);
+
+        // Only grow if the live elements need it, otherwise rebuild at the same size
+        if (liveFactor > mConfig.MaxLoadFactor_)
+        {
+            Rebuild(GrownTableSize());
+            mStats.Expansions_++;
+        }
+        else
+        {
+            Rebuild(mStats.TableSize_);
+        }
+    }
+
+    OAHTNodeTable* table = mTable.load(std::memory_order_relaxed);
+    unsigned fingerprint = Fingerprint(Key);
+    unsigned index, stride;
+    ProbeStart(Key, fingerprint, table, index, stride);
+
+    // Walk to the first empty slot, checking for duplicates and remembering the first tombstone
+    int reuse = -1;
+    for (unsigned probes = 0; probes < table->Size; ++probes)
+    {
+        ++mStats.Probes_;
+
+        OAHTNode* node = table->Slots[index].load(std::memory_order_relaxed);
+
+        if (!node)
+            break;
+
+        if (node == Tombstone())
+        {
+            if (reuse == -1)
+                reuse = index;
+        }
+        // Throw an exception if there's a duplicate
+        else if (node->Hash == fingerprint && strcmp(node->Key, Key) == 0)
+        {
+            throw OAHashTableException(OAHashTableException::E_DUPLICATE, "Found duplicate item.");
+        }
+
+        index += stride;
+
+        // Wrap around the array if needed
+        if (index > table->Size - 1)
+            index -= table->Size;
+    }
+
+    OAHTNode* node = new OAHTNode;
+    strcpy(node->Key, Key);
+    node->Data = Data;
+    node->Hash = fingerprint;
+
+    if (reuse != -1)
+    {
+        index = reuse;
+        --mTombstones;
+    }
+
+    // Publish the node once it is complete
+    table->Slots[index].store(node, std::memory_order_release);
+
+    mStats.Count_++;
+}
+
+/**
+ * @brief Removes a key. Its slot becomes a tombstone and the node is freed once readers move on.
+ *
+ * @param Key - key to remove
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::remove(const char *Key)
+{
+    std::lock_guard<std::mutex> lock(mWriteLock);
+
+    Reclaim();
+
+    OAHTNodeTable* table = mTable.load(std::memory_order_relaxed);
+    unsigned fingerprint = Fingerprint(Key);
+    unsigned index, stride;
+    ProbeStart(Key, fingerprint, table, index, stride);
+
+    for (unsigned probes = 0; probes < table->Size; ++probes)
+    {
+        ++mStats.Probes_;
+
+        OAHTNode* node = table->Slots[index].load(std::memory_order_relaxed);
+
+        if (!node)
+            break;
+
+        if (node != Tombstone() && node->Hash == fingerprint && strcmp(node->Key, Key) == 0)
+        {
+            // Readers walking past this slot continue over the tombstone
+            table->Slots[index].store(Tombstone(), std::memory_order_release);
+            Retire(node, 0);
+
+            mStats.Count_--;
+            ++mTombstones;
+            return;
+        }
+
+        index += stride;
+
+        // Wrap around the array if needed
+        if (index > table->Size - 1)
+            index -= table->Size;
+    }
+
+    throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+}
+
+/**
+ * @brief Finds an element and copies its data out. Never blocks.
+ *
+ * @param Key - the key to search for
+ * @param Data - set to the element's data if it was found
+ * @return true - the key was found
+ */
+template<typename T>
+bool ConcurrentOAHashTable<T>::find(const char *Key, T& Data) const
+{
+    OAHTEpochDomain::Guard guard;
+
+    const OAHTNodeTable* table = mTable.load(std::memory_order_acquire);
+    unsigned fingerprint = Fingerprint(Key);
+    unsigned index, stride;
+    ProbeStart(Key, fingerprint, table, index, stride);
+
+    // At most one pass over the table
+    for (unsigned probes = 0; probes < table->Size; ++probes)
+    {
+        const OAHTNode* node = table->Slots[index].load(std::memory_order_acquire);
+
+        if (!node)
+            return false;
+
+        if (node != Tombstone() && node->Hash == fingerprint && strcmp(node->Key, Key) == 0)
+        {
+            Data = node->Data;
+            return true;
+        }
+
+        index += stride;
+
+        // Wrap around the array if needed
+        if (index > table->Size - 1)
+            index -= table->Size;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Finds an element in the table by key
+ *
+ * @param Key - the key to search for
+ * @return T - a copy of the data associated with the key
+ */
+template<typename T>
+T ConcurrentOAHashTable<T>::find(const char *Key) const
+{
+    T data;
+
+    if (!find(Key, data))
+        throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Item not found in table.");
+
+    return data;
+}
+
+/**
+ * @brief Removes every element. Readers still in the old table keep seeing it until they finish.
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::clear()
+{
+    std::lock_guard<std::mutex> lock(mWriteLock);
+
+    OAHTNodeTable* table = mTable.load(std::memory_order_relaxed);
+
+    mTable.store(AllocateTable(table->Size), std::memory_order_release);
+
+    // The old table and every node in it are freed once readers move on
+    unsigned long long epoch = OAHTEpochDomain::Global().Retire();
+
+    for (unsigned i = 0; i < table->Size; ++i)
+    {
+        OAHTNode* node = table->Slots[i].load(std::memory_order_relaxed);
+
+        if (node && node != Tombstone())
+        {
+            Retired retired = {epoch, node, 0};
+            mRetired.push_back(retired);
+        }
+    }
+
+    Retired retired = {epoch, 0, table};
+    mRetired.push_back(retired);
+
+    mStats.Count_ = 0;
+    mTombstones = 0;
+
+    Reclaim();
+}
+
+/**
+ * @brief Returns the stats of the hash table.
+ */
+template<typename T>
+OAHTStats ConcurrentOAHashTable<T>::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mWriteLock);
+
+    return mStats;
+}
+
+/**
+ * @brief Allocates a table with every slot empty
+ *
+ * @param tableSize - the number of slots
+ */
+template<typename T>
+typename ConcurrentOAHashTable<T>::OAHTNodeTable* ConcurrentOAHashTable<T>::AllocateTable(unsigned tableSize) const
+{
+    OAHTNodeTable* table = new OAHTNodeTable;
+    table->Size = tableSize;
+    table->IndexModulo = FastModulo(tableSize);
+    table->StrideModulo = FastModulo(tableSize > 1 ? tableSize - 1 : 1);
+    table->Slots = new std::atomic<OAHTNode*>[tableSize];
+
+    for (unsigned i = 0; i < tableSize; ++i)
+        table->Slots[i].store(0, std::memory_order_relaxed);
+
+    return table;
+}
+
+/**
+ * @brief Deletes a table (not the nodes in it)
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::FreeTable(OAHTNodeTable* table) const
+{
+    delete [] table->Slots;
+    delete table;
+}
+
+/**
+ * @brief Frees a node's data with the client-provided free policy and deletes it
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::FreeNode(OAHTNode* node) const
+{
+    if (mConfig.FreeProc_)
+        mConfig.FreeProc_(node->Data);
+
+    delete node;
+}
+
+/**
+ * @brief Moves every node into a new table and publishes it. The nodes are shared by both
+ *        tables, so only the old slot array is retired.
+ *
+ * @param tableSize - the size of the new table
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::Rebuild(unsigned tableSize)
+{
+    OAHTNodeTable* oldTable = mTable.load(std::memory_order_relaxed);
+    OAHTNodeTable* newTable = AllocateTable(tableSize);
+
+    for (unsigned i = 0; i < oldTable->Size; ++i)
+    {
+        OAHTNode* node = oldTable->Slots[i].load(std::memory_order_relaxed);
+
+        if (!node || node == Tombstone())
+            continue;
+
+        unsigned index, stride;
+        ProbeStart(node->Key, node->Hash, newTable, index, stride);
+
+        // Nothing else is in the new table yet, so just find an empty slot
+        while (newTable->Slots[index].load(std::memory_order_relaxed))
+        {
+            ++mStats.Probes_;
+
+            index += stride;
+
+            // Wrap around the array if needed
+            if (index > tableSize - 1)
+                index -= tableSize;
+        }
+
+        ++mStats.Probes_;
+        newTable->Slots[index].store(node, std::memory_order_relaxed);
+    }
+
+    // Readers pick up the new table from here on
+    mTable.store(newTable, std::memory_order_release);
+    Retire(0, oldTable);
+
+    mStats.TableSize_ = tableSize;
+    mTombstones = 0;
+}
+
+/**
+ * @brief Queues an unlinked node or table to be freed when no reader can see it
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::Retire(OAHTNode* node, OAHTNodeTable* table)
+{
+    Retired retired = {OAHTEpochDomain::Global().Retire(), node, table};
+    mRetired.push_back(retired);
+}
+
+/**
+ * @brief Frees everything that no reader can still see
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::Reclaim()
+{
+    if (mRetired.empty())
+        return;
+
+    unsigned long long oldest = OAHTEpochDomain::Global().OldestReader();
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < mRetired.size(); ++i)
+    {
+        if (mRetired[i].Epoch >= oldest)
+        {
+            mRetired[kept++] = mRetired[i];
+            continue;
+        }
+
+        if (mRetired[i].Node)
+            FreeNode(mRetired[i].Node);
+        if (mRetired[i].Table)
+            FreeTable(mRetired[i].Table);
+    }
+
+    mRetired.resize(kept);
+}
+
+/**
+ * @brief Computes the key's fingerprint (the full-width hash folded to 32 bits, if there is one)
+ */
+template<typename T>
+unsigned ConcurrentOAHashTable<T>::Fingerprint(const char *Key) const
+{
+    if (mConfig.FullHashFunc_)
+    {
+        unsigned long long hash = mConfig.FullHashFunc_(Key);
+        return static_cast<unsigned>(hash ^ (hash >> 32));
+    }
+
+    return KeyFingerprint(Key);
+}
+
+/**
+ * @brief Computes where a key's probe sequence starts and its stride, the same way OAHashTable does
+ *
+ * @param Key - the key
+ * @param fingerprint - the key's fingerprint
+ * @param table - the table (its size, and the remainders by it)
+ * @param index - set to the key's home index
+ * @param stride - set to the stride (1 for linear probing)
+ */
+template<typename T>
+void ConcurrentOAHashTable<T>::ProbeStart(const char *Key, unsigned fingerprint, const OAHTNodeTable* table, unsigned& index, unsigned& stride) const
+{
+    unsigned tableSize = table->Size;
+    stride = 1;
+
+    bool powerOfTwo = mConfig.SizingPolicy_ == POWER_OF_TWO_SIZES;
+
+    if (mConfig.FullHashFunc_)
+    {
+        index = powerOfTwo ? fingerprint & (tableSize - 1) : table->IndexModulo(fingerprint);
+
+        if (mConfig.DoubleHashing_)
+        {
+            unsigned mixed = ((fingerprint << 16) | (fingerprint >> 16)) * 0x9E3779B1u;
+            stride = powerOfTwo ? (mixed & (tableSize - 1)) | 1 : table->StrideModulo(mixed) + 1;
+        }
+
+        return;
+    }
+
+    index = mConfig.PrimaryHashFunc_(Key, tableSize);
+
+    if (mConfig.SecondaryHashFunc_)
+    {
+        stride = mConfig.SecondaryHashFunc_(Key, tableSize - 1) + 1;
+
+        if (powerOfTwo)
+            stride |= 1;
+    }
+}
+
+/**
+ * @brief Calculates the size the table grows to
+ */
+template<typename T>
+unsigned ConcurrentOAHashTable<T>::GrownTableSize() const
+{
+    double factor = std::ceil(mStats.TableSize_ * mConfig.GrowthFactor_);
+
+    // Sizes stop at the largest 32-bit value
+    if (factor > 4294967295.0)
+        factor = 4294967295.0;
+
+    if (mConfig.SizingPolicy_ == POWER_OF_TWO_SIZES)
+        return GetNextPowerOfTwo(static_cast<unsigned>(factor) > mStats.TableSize_ ? static_cast<unsigned>(factor) : mStats.TableSize_ + 1);
+
+    return GetClosestPrime(static_cast<unsigned>(factor));
+}
+
+/**
+ * @brief Returns the marker stored in removed slots (never dereferenced)
+ */
+template<typename T>
+typename ConcurrentOAHashTable<T>::OAHTNode* ConcurrentOAHashTable<T>::Tombstone()
+{
+    static char marker;
+
+    return reinterpret_cast<OAHTNode*>(&marker);
+}
@@ -0,0 +1,169 @@
+/**
+ * @file ConcurrentOAHashTable.h
+ * @author Adam Lonstein (adam.lonstein@digipen.com)
+ * @brief A read-mostly concurrent version of the open-addressing hash table. Any number of threads
+ *        can call find() while one thread at a time inserts or removes (writers are serialized with
+ *        a lock). Readers never block and never write shared memory. A reader copies the data out
+ *        while it is protected by its epoch, and removed elements and old tables are freed once no
+ *        reader can still see them.
+ * @date 10-14-2026
+ */
+
+//---------------------------------------------------------------------------
+#ifndef CONCURRENTOAHASHTABLEH
+#define CONCURRENTOAHASHTABLEH
+//---------------------------------------------------------------------------
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "OAHashTable.h"
+
+//! Epoch-based reclamation shared by every concurrent table
+class OAHTEpochDomain
+{
+  public:
+      //! One per reader thread, reused after the thread exits
+    struct Record
+    {
+      Record() : Epoch(0), InUse(false), Next(0) {}
+
+      std::atomic<unsigned long long> Epoch; //!< Epoch the reader entered in, 0 when quiescent
+      std::atomic<bool> InUse;               //!< Owned by a live thread
+      Record* Next;                          //!< Next record in the domain
+      char Padding[64];                      //!< Keep readers off each other's cache lines
+    };
+
+      //! Marks the calling thread as reading for its lifetime (wait-free)
+    class Guard
+    {
+      public:
+        Guard() : mRecord(Global().ThreadRecord())
+        {
+          mRecord->Epoch.store(Global().mEpoch.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        ~Guard()
+        {
+          mRecord->Epoch.store(0, std::memory_order_release);
+        }
+
+      private:
+        Guard(const Guard&);
+        Guard& operator=(const Guard&);
+
+        Record* mRecord;
+    };
+
+      // The process-wide domain
+    static OAHTEpochDomain& Global();
+
+      // Advances the epoch, returning the epoch retired objects are stamped with
+    unsigned long long Retire();
+
+      // Oldest epoch a reader is in (objects retired before it can be freed)
+    unsigned long long OldestReader() const;
+
+  private:
+    OAHTEpochDomain() : mEpoch(1), mHead(0) {}
+
+    Record* ThreadRecord();
+    Record* AcquireRecord();
+
+    std::atomic<unsigned long long> mEpoch; //!< The global epoch
+    std::atomic<Record*> mHead;             //!< Reader records (never freed)
+};
+
+/*!
+Hash table definition (open-addressing, wait-free find). Uses the hash
+functions, load/growth factors, sizing policy and free proc of the
+config. Removals always leave tombstones (a PACK would move elements
+under running readers), which are dropped whenever the table is rebuilt.
+The layout, collision policy, hash caching and incremental resize
+options don't apply.
+*/
+template <typename T>
+class ConcurrentOAHashTable
+{
+  public:
+
+    typedef typename OAHashTable<T>::FREEPROC FREEPROC;     //!< client-provided free proc (we own the data)
+    typedef typename OAHashTable<T>::OAHTConfig OAHTConfig; //!< Same configuration as OAHashTable
+
+      //! An element. Never changes while it is linked into the table.
+    struct OAHTNode
+    {
+      char Key[MAX_KEYLEN]; //!< Key is a string
+      T Data;               //!< Client data
+      unsigned Hash;        //!< Fingerprint of the key
+    };
+
+    ConcurrentOAHashTable(const OAHTConfig& Config); // Constructor
+    ~ConcurrentOAHashTable();                        // Destructor (no other thread may use the table)
+
+      // Insert a key/data pair into table. Throws an exception if the
+      // insertion is unsuccessful. Serialized with other writers.
+    void insert(const char *Key, const T& Data);
+
+      // Delete an item by key. Throws an exception if the key doesn't exist.
+      // Serialized with other writers.
+    void remove(const char *Key);
+
+      // Find and copy data by key. Returns false if not found. Wait-free.
+    bool find(const char *Key, T& Data) const;
+
+      // Find and return a copy of the data by key. Throws an exception
+      // (E_ITEM_NOT_FOUND) if not found. Wait-free.
+    T find(const char *Key) const;
+
+      // Removes all items from the table (Doesn't shrink the table)
+    void clear();
+
+      // Stats of the writers (readers don't count probes)
+    OAHTStats GetStats() const;
+
+  private:
+      //! A published table. Slots are 0 (empty), the tombstone, or a node.
+    struct OAHTNodeTable
+    {
+      unsigned Size;                 //!< Number of slots
+      FastModulo IndexModulo;        //!< % Size, for home slots
+      FastModulo StrideModulo;       //!< % (Size - 1), for double hashing strides
+      std::atomic<OAHTNode*>* Slots; //!< The slots
+    };
+
+      //! Something a reader might still be looking at
+    struct Retired
+    {
+      unsigned long long Epoch; //!< Epoch it was unlinked in
+      OAHTNode* Node;           //!< A removed node, or 0
+      OAHTNodeTable* Table;     //!< A replaced table, or 0
+    };
+
+    OAHTNodeTable* AllocateTable(unsigned tableSize) const;
+    void FreeTable(OAHTNodeTable* table) const;
+    void FreeNode(OAHTNode* node) const;
+
+      // Rebuilds the table into a new one of the given size, dropping tombstones
+    void Rebuild(unsigned tableSize);
+    void Retire(OAHTNode* node, OAHTNodeTable* table);
+    void Reclaim();
+
+    unsigned Fingerprint(const char *Key) const;
+    void ProbeStart(const char *Key, unsigned fingerprint, const OAHTNodeTable* table, unsigned& index, unsigned& stride) const;
+    unsigned GrownTableSize() const;
+
+    static OAHTNode* Tombstone();
+
+    std::atomic<OAHTNodeTable*> mTable; //!< The current table, read by find()
+    mutable std::mutex mWriteLock;      //!< Serializes writers
+    std::vector<Retired> mRetired;      //!< Waiting for readers to move on
+    unsigned mTombstones;               //!< Removed slots in the current table
+
+    OAHTConfig mConfig;
+    OAHTStats mStats;
+};
+
+#include "ConcurrentOAHashTable.cpp"
+
+#endif
@@ -3,393 +3,3940 @@
  * @author Adam Lonstein (adam.lonstein@digipen.com)
  * @brief This implements a hash table. The hash table can use both linear probing and double hashing
  *        collision resolutions. The hash table can use both MARK and PACK deletion policies. The hashing
- *        function(s) must be client-provided.
+ *        function(s) can be client-provided (HashKey of Support.h by default).
  * @date 04-12-2024
  */
 
 #include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 /**
- * @brief Initializes the config, stats, and table
+ * @brief The hash functions as the stats keep them (they only have room for the string
+ *        hash functions, so the others are 0)
+ */
+inline HASHFUNC OAHTStatsHashFunc(HASHFUNC Func) { return Func; }
+inline FULLHASHFUNC OAHTStatsHashFunc(FULLHASHFUNC Func) { return Func; }
+template<typename Func> inline std::nullptr_t OAHTStatsHashFunc(Func) { return nullptr; }
+
+/**
+ * @brief Starts loading the cache line of an address that's about to be read
+ */
+inline void OAHTPrefetch(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(__SSE2__) || defined(_M_X64)
+    _mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+/**
+ * @brief Returns the key, inline or in the arena
  */
-template<typename T>
-OAHashTable<T>::OAHashTable(const OAHTConfig& Config) : mTable(new OAHTSlot[Config.InitialTableSize_]), mConfig(Config), mStats()
+inline OAHTArenaKeys::Stored::operator const char *() const
 {
-    mStats.TableSize_ = Config.InitialTableSize_;
+    if (!Bytes[INLINE_KEYLEN - 1])
+        return Bytes;
 
-    mStats.PrimaryHashFunc_ = mConfig.PrimaryHashFunc_;
-    mStats.SecondaryHashFunc_ = mConfig.SecondaryHashFunc_;
+    const char* copy;
+    memcpy(&copy, Bytes, sizeof(copy));
 
-    // Set all slots in table to unoccupied
-    for(unsigned int i = 0; i < mConfig.InitialTableSize_; ++i)
-    {
-        mTable[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
-    }
+    return copy;
 }
 
 /**
- * @brief Deletes the hash table
+ * @brief Frees every block of the arena
  */
-template<typename T>
-OAHashTable<T>::~OAHashTable()
+inline OAHTArenaKeys::~OAHTArenaKeys()
 {
-    clear();
+    while (mBlocks)
+    {
+        Block* next = mBlocks->Next;
+
+        delete [] mBlocks->Data;
+        delete mBlocks;
 
-    delete [] mTable;
+        mBlocks = next;
+    }
 }
 
 /**
- * @brief Grows the table if the load factor is greater than max load factor. Then inserts into the table.
+ * @brief Stores a key, inline if it's short enough, otherwise in the arena. Value may be
+ *        the stored key itself (it's read before the stored key changes).
  * 
- * @param Key - key to insert
- * @param Data - data to insert
+ * @param Key - where the key is stored
+ * @param Value - the key
  */
-template<typename T>
-void OAHashTable<T>::insert(const char *Key, const T& Data)
+inline void OAHTArenaKeys::Set(Stored& Key, const char *Value)
 {
-    double loadFactor = static_cast<double>(mStats.Count_ + 1) / static_cast<double>(mStats.TableSize_);
+    size_t length = strlen(Value);
 
-    // Grow the table if needed
-    if(loadFactor > mConfig.MaxLoadFactor_)
+    if (length < INLINE_KEYLEN - 1)
     {
-        GrowTable();
+        memmove(Key.Bytes, Value, length + 1);
+        Key.Bytes[INLINE_KEYLEN - 1] = 0;
+
+        return;
     }
 
-    // Insert the key/data into the table
-    InsertInTable(mTable, mStats.TableSize_, Key, Data);
-    mStats.Count_++;
+    char* copy = Allocate(static_cast<unsigned>(length + 1));
+    memcpy(copy, Value, length + 1);
+
+    memcpy(Key.Bytes, &copy, sizeof(copy));
+    Key.Bytes[INLINE_KEYLEN - 1] = 1;
 }
 
 /**
- * @brief Removes a slot from the table. Either uses MARK or PACK policy.
+ * @brief Exchanges the arenas (and what they hold) of two stores
+ */
+inline void OAHTArenaKeys::Swap(OAHTArenaKeys& Other)
+{
+    std::swap(mBlocks, Other.mBlocks);
+    std::swap(mUsed, Other.mUsed);
+    std::swap(mLive, Other.mLive);
+}
+
+/**
+ * @brief Bump-allocates bytes from the current block, starting a new block when it's full
  * 
- * @param Key - key to remove
+ * @param bytes - the number of bytes
+ * @return char* - the bytes
  */
-template<typename T>
-void OAHashTable<T>::remove(const char *Key)
+inline char* OAHTArenaKeys::Allocate(unsigned bytes)
 {
-    OAHTSlot* slot;
+    if (!mBlocks || mBlocks->Size - mBlocks->Used < bytes)
+    {
+        Block* block = new Block;
+        block->Size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+        block->Used = 0;
+        block->Data = new char[block->Size];
+        block->Next = mBlocks;
 
-    // Get the index of this key in the table
-    int index = IndexOf(Key, slot);
+        mBlocks = block;
+    }
 
-    // Throw an exception if the index doesn't exist
-    if(index == -1)
+    char* bytesOut = mBlocks->Data + mBlocks->Used;
+    mBlocks->Used += bytes;
+    mUsed += bytes;
+
+    return bytesOut;
+}
+
+/**
+ * @brief Takes the file of a background snapshot, its header written, and starts the thread
+ *        that copies and writes the chunks
+ * 
+ * @param File - the file, opened for binary writing
+ * @param Path - its name once it's complete
+ * @param TempPath - its name while it's written
+ * @param ChunkSlots - slots per chunk (a multiple of 64, so no occupancy word is split)
+ * @param Chunks - chunks in the table
+ * @param Regions - the table memory each chunk has a part of
+ * @param RegionCount - how many regions
+ */
+inline OAHTSnapshotWriter::OAHTSnapshotWriter(FILE* File, const char* Path, const char* TempPath, unsigned ChunkSlots,
+                                              unsigned Chunks, const Region* Regions, unsigned RegionCount)
+    : mFile(File), mPath(Path), mTempPath(TempPath), mChunkSlots(ChunkSlots), mChunks(Chunks), mRegionCount(RegionCount), mChunkBytes(0),
+      mStates(Chunks), mCopied(0), mWritten(0), mFailed(false), mSucceeded(false), mFinished(false)
+{
+    for(unsigned i = 0; i < RegionCount; ++i)
     {
-        throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+        mRegions[i] = Regions[i];
+        mChunkBytes += Regions[i].Unit;
     }
-     
-    // An element is getting removed
-    mStats.Count_--;
 
-    if(mConfig.DeletionPolicy_ == OAHTDeletionPolicy::PACK)
+    // All the memory it will use, up front
+    mBuffer.resize(mChunkBytes);
+    mCopies.assign(QUEUE, std::vector<char>(mChunkBytes));
+    mCopyOf.assign(QUEUE, FREE);
+
+    mThread = std::thread(&OAHTSnapshotWriter::Run, this);
+}
+
+/**
+ * @brief Lets the thread finish the file
+ */
+inline OAHTSnapshotWriter::~OAHTSnapshotWriter()
+{
+    if(mThread.joinable())
+        mThread.join();
+}
+
+/**
+ * @brief Makes sure the chunks holding a run of slots are copied before a change to them
+ * 
+ * @param First - the first slot of the run
+ * @param Last - the last slot of the run (less than First when it wraps around the end)
+ */
+inline void OAHTSnapshotWriter::CopySlots(unsigned First, unsigned Last)
+{
+    if(First > Last)
     {
-        // Use the client-provided free policy on the element
-        if(mConfig.FreeProc_)
-            mConfig.FreeProc_(slot->Data);
+        CopyChunks(First / mChunkSlots, mChunks - 1);
+        First = 0;
+    }
 
-        // Set the slot to unoccupied
-        slot->State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+    CopyChunks(First / mChunkSlots, Last / mChunkSlots);
+}
 
-        int originalIndex = index;
-        index++; // Go to the next index
+/**
+ * @brief Waits for the file to be written
+ * 
+ * @return bool - false if it couldn't be
+ */
+inline bool OAHTSnapshotWriter::Wait()
+{
+    if(mThread.joinable())
+        mThread.join();
 
-        // Wrap around array if necessary
-        if(static_cast<unsigned>(index) > mStats.TableSize_ - 1)
+    return mSucceeded;
+}
+
+/**
+ * @brief The thread: copies and writes the chunks in order (skipping those a change copied),
+ *        writing the changes' copies as they come, then finishes the file
+ */
+inline void OAHTSnapshotWriter::Run()
+{
+    for(unsigned chunk = 0; chunk < mChunks; ++chunk)
+    {
+        // Free the buffers first, so changes don't wait on them
+        while(WriteCopy(false))
         {
-            index = 0;
         }
 
-        // For every remaining element in the cluster
-        while(mTable[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED && index != originalIndex)
+        if(Claim(chunk))
         {
-            // Set the element to unoccupied
-            mTable[index].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+            Copy(chunk, &mBuffer[0]);
+            Copied(chunk);
+            Write(chunk, &mBuffer[0]);
+        }
+    }
 
-            // Re-insert the element into the table
-            InsertInTable(mTable, mStats.TableSize_, mTable[index].Key, mTable[index].Data);
+    // The chunks that changes copied and haven't handed over yet
+    while(mWritten < mChunks)
+        WriteCopy(true);
 
-            index++;
-            
-            // Wrap around array if necessary
-            if(static_cast<unsigned>(index) > mStats.TableSize_ - 1)
+    bool written = !mFailed;
+    if(fclose(mFile) != 0)
+        written = false;
+    if(written && std::rename(mTempPath.c_str(), mPath.c_str()) != 0)
+        written = false;
+    if(!written)
+        std::remove(mTempPath.c_str());
+
+    mSucceeded = written;
+    mFinished.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Copies the chunks that aren't yet, for a change that's about to write to them.
+ *        Waits for the thread instead if it's copying one, or for a free buffer.
+ * 
+ * @param first - the first chunk
+ * @param last - the last chunk
+ */
+inline void OAHTSnapshotWriter::CopyChunks(unsigned first, unsigned last)
+{
+    for(unsigned chunk = first; chunk <= last; ++chunk)
+    {
+        if(mStates[chunk].load(std::memory_order_acquire) == COPIED)
+            continue;
+
+        if(!Claim(chunk))
+        {
+            // The thread copies a chunk in one go
+            while(mStates[chunk].load(std::memory_order_acquire) != COPIED)
+                std::this_thread::yield();
+
+            continue;
+        }
+
+        unsigned buffer;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            for(;;)
             {
-                index = 0;
+                for(buffer = 0; buffer < QUEUE && mCopyOf[buffer] != FREE; ++buffer)
+                {
+                }
+
+                if(buffer < QUEUE)
+                    break;
+
+                mChanged.wait(lock);
             }
+
+            mCopyOf[buffer] = FILLING;
         }
-    }
-    else if(mConfig.DeletionPolicy_ == OAHTDeletionPolicy::MARK)
-    {
-        // Simple mark the element as deleted
-        mTable[index].State = OAHTSlot::OAHTSlot_State::DELETED;
+
+        Copy(chunk, &mCopies[buffer][0]);
+        Copied(chunk);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCopyOf[buffer] = chunk;
+        }
+
+        mChanged.notify_all();
     }
 }
 
 /**
- * @brief Finds an element in the table by key
+ * @brief Takes a chunk to copy, unless the thread or a change already has
  * 
- * @param Key - the key to search for 
- * @return const T& - returns the data associated with the key
+ * @param chunk - the chunk
+ * @return bool - true if it's this caller's to copy
  */
-template<typename T>
-const T& OAHashTable<T>::find(const char *Key) const
+inline bool OAHTSnapshotWriter::Claim(unsigned chunk)
 {
-    OAHTSlot* slot;
+    unsigned char uncopied = UNCOPIED;
 
-    // Get the index of the key (throw an exception if it doesn't exist)
-    if(IndexOf(Key, slot) == -1)
-        throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Item not found in table.");
-
-    return slot->Data; // Return the found slots data
+    return mStates[chunk].compare_exchange_strong(uncopied, COPYING, std::memory_order_acquire);
 }
 
 /**
- * @brief Clears and cleans up the hash table
+ * @brief Copies the parts of a chunk, one region after the other
+ * 
+ * @param chunk - the chunk
+ * @param bytes - where the copy goes (mChunkBytes)
  */
-template<typename T>
-void OAHashTable<T>::clear()
+inline void OAHTSnapshotWriter::Copy(unsigned chunk, char* bytes) const
 {
-    for (unsigned int i = 0; i < mStats.TableSize_; ++i)
+    for(unsigned i = 0; i < mRegionCount; ++i)
     {
-        if (mTable[i].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED)
-        {
-            // Decrease count of the hash table (as long as it hasn't already through MARK policy)
-            if(mTable[i].State != OAHTSlot::OAHTSlot_State::DELETED)
-                --mStats.Count_;
-
-            // Use the free policy to free the data
-            if (mConfig.FreeProc_)
-                mConfig.FreeProc_(mTable[i].Data);
+        size_t count = RegionBytes(mRegions[i], chunk);
 
-            // The slot is now unoccupied
-            mTable[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
-        }
+        memcpy(bytes, mRegions[i].Memory + static_cast<size_t>(chunk) * mRegions[i].Unit, count);
+        bytes += count;
     }
 }
 
 /**
- * @brief Returns the stats of the hash table.
+ * @brief Marks a claimed chunk copied, so the table can change it
+ * 
+ * @param chunk - the chunk
  */
-template<typename T>
-OAHTStats OAHashTable<T>::GetStats() const
+inline void OAHTSnapshotWriter::Copied(unsigned chunk)
 {
-    return mStats;
+    mStates[chunk].store(COPIED, std::memory_order_release);
+    mCopied.fetch_add(1, std::memory_order_release);
 }
 
 /**
- * @brief Returns a pointer to the hash table.
+ * @brief Writes the parts of a copied chunk where they go in the file (in the thread)
+ * 
+ * @param chunk - the chunk
+ * @param bytes - its copy
  */
-template<typename T>
-const typename OAHashTable<T>::OAHTSlot* OAHashTable<T>::GetTable() const
+inline void OAHTSnapshotWriter::Write(unsigned chunk, const char* bytes)
 {
-    return mTable;
+    for(unsigned i = 0; i < mRegionCount && !mFailed; ++i)
+    {
+        size_t count = RegionBytes(mRegions[i], chunk);
+
+        if(count && !WriteFileAt(mFile, mRegions[i].Offset + static_cast<unsigned long long>(chunk) * mRegions[i].Unit, bytes, count))
+            mFailed = true;
+
+        bytes += count;
+    }
+
+    ++mWritten;
 }
 
 /**
- * @brief Inserts into a given table. This function assumes there will be room in the table.
+ * @brief Writes a chunk a change copied and frees its buffer (in the thread)
  * 
- * @param table - the table to insert pair in
- * @param Key - the key to insert
- * @param Data - the data to insert
+ * @param wait - wait for one if there is none
+ * @return bool - false if there was none
  */
-template<typename T>
-void OAHashTable<T>::InsertInTable(OAHTSlot* table, unsigned tableSize, const char* Key, const T& Data)
+inline bool OAHTSnapshotWriter::WriteCopy(bool wait)
 {
-    unsigned index = mConfig.PrimaryHashFunc_(Key, tableSize);
-
-    unsigned stride = 1;
-
-    // If we are doing double hashing, get the stride/increment
-    if (mConfig.SecondaryHashFunc_)
-        stride = mConfig.SecondaryHashFunc_(Key, tableSize - 1) + 1;
-
-    // Search for an open spot in the array
-    while (table[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+    unsigned buffer, chunk = FREE;
     {
-        // Throw an exception if there's a duplicate
-        if (strcmp(table[index].Key, Key) == 0)
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        for(;;)
         {
-            throw OAHashTableException(OAHashTableException::E_DUPLICATE, "Found duplicate item.");
-        }
+            // FREE and FILLING are past every chunk
+            for(buffer = 0; buffer < QUEUE && mCopyOf[buffer] >= mChunks; ++buffer)
+            {
+            }
 
-        index += stride; // Go to the next index by stride
+            if(buffer < QUEUE || !wait)
+                break;
 
-        // Wrap around the array if needed
-        if (index > tableSize - 1)
-        {
-            index -= tableSize;
+            mChanged.wait(lock);
         }
 
-        mStats.Probes_++;
+        if(buffer == QUEUE)
+            return false;
+
+        chunk = mCopyOf[buffer];
     }
 
-    // If the slot that was inserted into was a deleted slot, check for duplicates
-    if (table[index].State == OAHTSlot::OAHTSlot_State::DELETED && mConfig.DeletionPolicy_ == OAHTDeletionPolicy::MARK)
+    Write(chunk, &mCopies[buffer][0]);
+
     {
-        CheckForMarkInsertionDuplicate(index, stride, table, tableSize, Key);
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCopyOf[buffer] = FREE;
     }
 
-    ++mStats.Probes_;
+    mChanged.notify_all();
+
+    return true;
+}
 
-    // Insert the data into the slot
-    strcpy(table[index].Key, Key);
-    table[index].Data = Data;
+/**
+ * @brief The bytes of a region in a chunk
+ * 
+ * @param region - the region
+ * @param chunk - the chunk
+ * @return size_t - Unit, less in the last chunk, 0 past the end
+ */
+inline size_t OAHTSnapshotWriter::RegionBytes(const Region& region, unsigned chunk) const
+{
+    size_t start = static_cast<size_t>(chunk) * region.Unit;
 
-    // The slot is now occupied
-    table[index].State = OAHTSlot::OAHTSlot_State::OCCUPIED;
+    if(start >= region.Bytes)
+        return 0;
 
+    return region.Bytes - start < region.Unit ? region.Bytes - start : region.Unit;
 }
 
 /**
- * @brief Grows the table (should only be called when load factor is past max load factor)
+ * @brief Initializes the config, stats, and table
  */
-template<typename T>
-void OAHashTable<T>::GrowTable()
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OAHashTable(const OAHTConfig& Config) : mTable(AllocateSlots(SizeFor(Config, Config.InitialTableSize_))), mControl(0),
+                                                          mOldTable(0), mOldControl(0), mOldTableSize(0), mMigrateIndex(0), mConfig(Config), mStats(),
+                                                          mSnapshot(0), mSnapshotBytes(0), mSnapshotWriter(0), mLog(0)
 {
-    // Calculate the new table size
-    double factor = std::ceil(mStats.TableSize_ * mConfig.GrowthFactor_);
-    unsigned newTableSize = GetClosestPrime(static_cast<unsigned>(factor));
+    mStats.TableSize_ = SizeFor(Config, Config.InitialTableSize_);
+    CacheModulo(mStats.TableSize_);
 
-    // Allocate the new table
-    OAHTSlot* newTable = new OAHTSlot[newTableSize];
+    Configure();
 
-    // Set all slots in new table to unoccupied
-    for(unsigned int i = 0; i < newTableSize; ++i)
+    mControl = AllocateControl(mStats.TableSize_);
+}
+
+/**
+ * @brief Maps a snapshot written by SaveSnapshot and serves the table from it. The mapping is
+ *        copy-on-write, so the pages are shared with other processes mapping the same file
+ *        until the table writes to them.
+ * 
+ * @param Config - the config the table was saved with (hash functions and policies)
+ * @param SnapshotPath - the snapshot file
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OAHashTable(const OAHTConfig& Config, const char *SnapshotPath) : mTable(0), mControl(0),
+                                                          mOldTable(0), mOldControl(0), mOldTableSize(0), mMigrateIndex(0), mConfig(Config), mStats(),
+                                                          mSnapshot(0), mSnapshotBytes(0), mSnapshotWriter(0), mLog(0)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshots need trivially copyable data");
+    static_assert(KeyStorage::SELF_CONTAINED, "Snapshots need keys that are stored in the slots");
+
+    Configure();
+
+    mSnapshot = static_cast<char*>(MapFile(SnapshotPath, mSnapshotBytes));
+    if(!mSnapshot)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't map the snapshot.");
+
+    const OAHTSnapshotHeader* header = reinterpret_cast<const OAHTSnapshotHeader*>(mSnapshot);
+    const char* mismatch = 0;
+
+    // The file must hold what the header says, laid out the way this table lays it out
+    if(mSnapshotBytes < sizeof(OAHTSnapshotHeader) || memcmp(header->Magic, SnapshotMagic(), sizeof(header->Magic)) != 0)
+        mismatch = "Not a snapshot.";
+    else if(header->SlotSize != sizeof(OAHTSlot) || header->DataSize != sizeof(T))
+        mismatch = "Snapshot has another slot layout.";
+    else if(header->TableSize == 0 || header->SlotsOffset % SNAPSHOT_ALIGNMENT ||
+            header->SlotsOffset + SlotBytes(header->TableSize) > mSnapshotBytes ||
+            header->ControlOffset + header->ControlBytes > mSnapshotBytes)
+        mismatch = "Snapshot is truncated.";
+    else if(header->Layout != static_cast<unsigned>(mConfig.LayoutPolicy_) || header->Collision != static_cast<unsigned>(mConfig.CollisionPolicy_) ||
+            header->Sizing != static_cast<unsigned>(mConfig.SizingPolicy_) || header->Deletion != static_cast<unsigned>(DeletionPolicy()) ||
+            header->Flags != SnapshotFlags() ||
+            (header->ControlBytes != 0) != (mConfig.LayoutPolicy_ == CONTROL_BYTES && mConfig.CollisionPolicy_ == PROBE_SEQUENCE) ||
+            (header->ControlBytes != 0 && header->ControlBytes != header->TableSize + OAHTControlGroup::WIDTH))
+        mismatch = "Snapshot was saved with other policies.";
+
+    if(!mismatch)
     {
-        newTable[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+        mTable = reinterpret_cast<OAHTSlot*>(mSnapshot + header->SlotsOffset);
+        mControl = header->ControlBytes ? reinterpret_cast<unsigned char*>(mSnapshot + header->ControlOffset) : 0;
+
+        mStats.TableSize_ = header->TableSize;
+        CacheModulo(mStats.TableSize_);
+        mStats.Count_ = header->Count;
+        mStats.Tombstones_ = header->Tombstones;
+
+        if(HashIdentity() != header->HashIdentity)
+            mismatch = "Snapshot was saved with other hash functions.";
     }
 
-    // Insert every slot in old table into new table
-    for(unsigned int i = 0; i < mStats.TableSize_; ++i)
+    if(mismatch)
     {
-        if(mTable[i].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
-        {
-            InsertInTable(newTable, newTableSize, mTable[i].Key, mTable[i].Data);
-        }
+        UnmapFile(mSnapshot, mSnapshotBytes);
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, mismatch);
     }
+}
 
-    // Delete the old table
-    delete [] mTable;
+/**
+ * @brief Deletes the hash table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::~OAHashTable()
+{
+    // Emptying the table isn't a change to log (CloseLog stops logging before clear() runs),
+    // and a snapshot being written is let finish (its thread reads the table). A destructor
+    // can't report a failed write.
+    try
+    {
+        CloseLog();
+    }
+    catch(const OAHashTableException&)
+    {
+    }
+    try
+    {
+        BackgroundSnapshotDone(true);
+    }
+    catch(const OAHashTableException&)
+    {
+    }
 
-    // Set table to the new table
-    mTable = newTable;
+    // Snapshot data is trivially copyable, so unless the free proc wants it there's nothing to
+    // free (and clearing would copy every page of the mapping just to mark it empty)
+    if(!mSnapshot || mConfig.FreeProc_)
+        clear();
 
-    mStats.TableSize_ = newTableSize;
-    mStats.Expansions_++;
+    if(mOldTable)
+        ReleaseOldTable();
+
+    ReleaseTable(mTable, mControl, mStats.TableSize_);
 }
 
 /**
- * @brief Finds the index of a key in the hash table
+ * @brief Sets up the parts of the table both constructors share
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Configure()
+{
+    // Keep the config in line with a fixed policy (the stats and analytics read it)
+    if(Policies::FIXED)
+    {
+        mConfig.DeletionPolicy_ = Policies::DELETION;
+        mConfig.CollisionPolicy_ = PROBE_SEQUENCE;
+        mConfig.CacheHashes_ = Policies::CACHE_HASHES;
+    }
+
+    mStats.PrimaryHashFunc_ = OAHTStatsHashFunc(mConfig.PrimaryHashFunc_);
+    mStats.SecondaryHashFunc_ = OAHTStatsHashFunc(mConfig.SecondaryHashFunc_);
+    mStats.FullHashFunc_ = OAHTStatsHashFunc(mConfig.FullHashFunc_);
+}
+
+/**
+ * @brief Writes the table to a file that the snapshot constructor maps back. The slots and
+ *        control bytes are written as they are, each starting on a page of its own.
  * 
- * @param Key - key to find
- * @param Slot - sets this to the found slot
- * @return int - returns the index of the slot, -1 if not found
+ * @param Path - the file to write
  */
-template<typename T>
-int OAHashTable<T>::IndexOf(const char *Key, OAHTSlot* &Slot) const
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SaveSnapshot(const char *Path)
 {
-    // Get the index with the primary hash function
-    unsigned index = mConfig.PrimaryHashFunc_(Key, mStats.TableSize_);
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshots need trivially copyable data");
+    static_assert(KeyStorage::SELF_CONTAINED, "Snapshots need keys that are stored in the slots");
 
-    unsigned stride = 1;
+    // The snapshot is one table
+    if(mOldTable)
+        MigrateSlots(mOldTableSize);
 
-    // If we are doing double hashing, get the stride/increment
-    if (mConfig.SecondaryHashFunc_)
-        stride = mConfig.SecondaryHashFunc_(Key, mStats.TableSize_ - 1) + 1;
+    OAHTSnapshotHeader header = SnapshotHeader();
+    unsigned long long slotBytes = SlotBytes(mStats.TableSize_);
 
-    unsigned originalIndex = index;
+    FILE* file = fopen(Path, "wb");
+    if(!file)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't create the snapshot.");
 
-    if(mTable[index].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
-        ++mStats.Probes_;
+    // Zeros to pad the header and the slots out to the next page
+    static const char padding[SNAPSHOT_ALIGNMENT] = {0};
 
-    // Walk the table with stride until an unoccupied slot is found
-    while(mTable[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED || mTable[index].State == OAHTSlot::OAHTSlot_State::DELETED)
-    {
-        ++mStats.Probes_;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(padding, 1, SNAPSHOT_ALIGNMENT - sizeof(header), file) == SNAPSHOT_ALIGNMENT - sizeof(header);
 
-        // If this is the slot, return
-        if(strcmp(mTable[index].Key, Key) == 0)
-        {
-            Slot = &mTable[index];
+    // The slots go out a chunk at a time, so the writes stay a bounded size
+    unsigned chunk = SNAPSHOT_CHUNK / sizeof(OAHTSlot) ? static_cast<unsigned>(SNAPSHOT_CHUNK / sizeof(OAHTSlot)) : 1;
 
-            return index;
-        }
+    for(unsigned done = 0; written && done < mStats.TableSize_; done += chunk)
+    {
+        unsigned slots = mStats.TableSize_ - done < chunk ? mStats.TableSize_ - done : chunk;
 
-        index += stride;
+        written = fwrite(mTable + done, sizeof(OAHTSlot), slots, file) == slots;
+    }
 
-        // Wrap around the array if needed
-        if(static_cast<unsigned>(index) > mStats.TableSize_ - 1)
-        {
-            index -= mStats.TableSize_;
-        }
+    if(written)
+    {
+        // Then the bitmap, on the 8 byte boundary it has in memory
+        size_t words = (mStats.TableSize_ + 63) / 64;
+        size_t gap = static_cast<size_t>(slotBytes) - words * sizeof(unsigned long long) - sizeof(OAHTSlot) * static_cast<size_t>(mStats.TableSize_);
+
+        written = fwrite(padding, 1, gap, file) == gap &&
+                  fwrite(Occupancy(mTable, mStats.TableSize_), sizeof(unsigned long long), words, file) == words;
+    }
 
-        if(mTable[index].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
-            ++mStats.Probes_;
+    if(written && mControl)
+    {
+        size_t gap = static_cast<size_t>(header.ControlOffset - header.SlotsOffset - slotBytes);
 
-        // Stop if it has come back to the original index
-        if(index == originalIndex)
-        {
-            break;
-        }
+        written = fwrite(padding, 1, gap, file) == gap &&
+                  fwrite(mControl, 1, static_cast<size_t>(header.ControlBytes), file) == header.ControlBytes;
     }
 
-    // If an unoccupied slot was found, the key is not in the array
-    return -1;
+    if(fclose(file) != 0 || !written)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't write the snapshot.");
 }
 
 /**
- * @brief Prints the array, debug purposes
+ * @brief Fills in the header of a snapshot of the table as it is (one table, not mid-resize)
+ * 
+ * @return OAHTSnapshotHeader - the header
  */
-template<typename T>
-void OAHashTable<T>::PrintTable(OAHTSlot* table, unsigned tableSize) const
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OAHTSnapshotHeader OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SnapshotHeader() const
 {
-    for(unsigned i = 0; i < tableSize; ++i)
-    {
-        if(table[i].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
-            std::cout << "Index " << i << ": " << "unoccupied";
-        else
-            std::cout << "Index " << i << ": " << table[i].Key;
-
-        std::cout << std::endl;
-    }
-
-    std::cout << std::endl;
+    OAHTSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+
+    memcpy(header.Magic, SnapshotMagic(), sizeof(header.Magic));
+    header.SlotSize = sizeof(OAHTSlot);
+    header.DataSize = sizeof(T);
+    header.TableSize = mStats.TableSize_;
+    header.Count = mStats.Count_;
+    header.Tombstones = mStats.Tombstones_;
+    header.Layout = mConfig.LayoutPolicy_;
+    header.Collision = mConfig.CollisionPolicy_;
+    header.Sizing = mConfig.SizingPolicy_;
+    header.Deletion = DeletionPolicy();
+    header.Flags = SnapshotFlags();
+    header.HashIdentity = HashIdentity();
+
+    // The slots are written with the occupancy bitmap that follows them
+    unsigned long long slotBytes = SlotBytes(mStats.TableSize_);
+    header.SlotsOffset = SNAPSHOT_ALIGNMENT;
+    header.ControlBytes = mControl ? mStats.TableSize_ + OAHTControlGroup::WIDTH : 0;
+    header.ControlOffset = mControl ? (header.SlotsOffset + slotBytes + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT : 0;
+
+    return header;
 }
 
 /**
- * @brief Checks for a duplicate item after a slot marked as deleted was inserted into.
+ * @brief Starts writing a snapshot of the table as it is now from a thread. Changes go on
+ *        meanwhile: each first has the thread's writer copy the chunks it can touch, so the
+ *        file keeps the table as it was. Switches the log at the same moment, if asked to.
  * 
- * @param index - index of inserted slot
- * @param stride - stride
+ * @param Path - the file to write (written under Path.tmp until it's complete)
+ * @param LogPath - the log to restart logging in (0 to leave the log as is)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::BeginBackgroundSnapshot(const char *Path, const char *LogPath)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshots need trivially copyable data");
+    static_assert(KeyStorage::SELF_CONTAINED, "Snapshots need keys that are stored in the slots");
+
+    // One snapshot at a time, of one table
+    BackgroundSnapshotDone(true);
+    if(mOldTable)
+        MigrateSlots(mOldTableSize);
+
+    OAHTSnapshotHeader header = SnapshotHeader();
+    unsigned long long slotBytes = SlotBytes(mStats.TableSize_);
+    size_t words = (mStats.TableSize_ + 63) / 64;
+    size_t slotsEnd = sizeof(OAHTSlot) * static_cast<size_t>(mStats.TableSize_);
+    unsigned long long bitmapOffset = header.SlotsOffset + slotBytes - words * sizeof(unsigned long long);
+
+    std::string tempPath = std::string(Path) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if(!file)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't create the snapshot.");
+
+    // The header and the padding between the parts go out now, the chunks from the thread
+    static const char padding[SNAPSHOT_ALIGNMENT] = {0};
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(padding, 1, SNAPSHOT_ALIGNMENT - sizeof(header), file) == SNAPSHOT_ALIGNMENT - sizeof(header) &&
+                   WriteFileAt(file, header.SlotsOffset + slotsEnd, padding, static_cast<size_t>(bitmapOffset - header.SlotsOffset - slotsEnd));
+
+    if(written && mControl)
+        written = WriteFileAt(file, header.SlotsOffset + slotBytes, padding, static_cast<size_t>(header.ControlOffset - header.SlotsOffset - slotBytes));
+
+    // A chunk is the slots of about SNAPSHOT_CHUNK bytes, whole occupancy words of them
+    unsigned chunk = static_cast<unsigned>(SNAPSHOT_CHUNK / sizeof(OAHTSlot) / 64 * 64);
+    if(chunk == 0)
+        chunk = 64;
+
+    OAHTSnapshotWriter::Region regions[OAHTSnapshotWriter::MAX_REGIONS];
+    unsigned regionCount = 0;
+
+    OAHTSnapshotWriter::Region slots = {reinterpret_cast<const char*>(mTable), header.SlotsOffset, chunk * sizeof(OAHTSlot), slotsEnd};
+    regions[regionCount++] = slots;
+
+    OAHTSnapshotWriter::Region bitmap = {reinterpret_cast<const char*>(Occupancy(mTable, mStats.TableSize_)), bitmapOffset, chunk / 8, words * sizeof(unsigned long long)};
+    regions[regionCount++] = bitmap;
+
+    if(mControl)
+    {
+        // The copy of the first group's control bytes past the end changes with the first chunk
+        OAHTSnapshotWriter::Region control = {reinterpret_cast<const char*>(mControl), header.ControlOffset, chunk, mStats.TableSize_};
+        OAHTSnapshotWriter::Region mirror = {reinterpret_cast<const char*>(mControl + mStats.TableSize_), header.ControlOffset + mStats.TableSize_,
+                                             OAHTControlGroup::WIDTH, OAHTControlGroup::WIDTH};
+        regions[regionCount++] = control;
+        regions[regionCount++] = mirror;
+    }
+
+    try
+    {
+        if(written)
+            mSnapshotWriter = new OAHTSnapshotWriter(file, Path, tempPath.c_str(), chunk, (mStats.TableSize_ + chunk - 1) / chunk, regions, regionCount);
+    }
+    catch(const std::exception&)
+    {
+        written = false;
+    }
+
+    if(!written)
+    {
+        fclose(file);
+        std::remove(tempPath.c_str());
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't start the snapshot writer.");
+    }
+
+    // Every change from here on is in the new log and not in the snapshot
+    if(LogPath)
+    {
+        CloseLog();
+        OpenLog(LogPath, false);
+    }
+}
+
+/**
+ * @brief Checks on (or waits for) the background snapshot
+ * 
+ * @param Wait - wait for it to be written
+ * @return bool - true if it has been written (or there is none)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::BackgroundSnapshotDone(bool Wait)
+{
+    if(!mSnapshotWriter)
+        return true;
+
+    if(!Wait && !mSnapshotWriter->Done())
+        return false;
+
+    bool written = mSnapshotWriter->Wait();
+
+    delete mSnapshotWriter;
+    mSnapshotWriter = 0;
+
+    if(!written)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't write the snapshot.");
+
+    return true;
+}
+
+/**
+ * @brief Has the background snapshot copy the chunks a change of a key can touch before it
+ *        changes them. Linear probing changes stay inside the cluster around the key's home
+ *        slot (the run between two unoccupied slots, which inserts fill and removes pack or
+ *        shift within). Double hashing and cuckoo changes can reach any slot.
+ * 
+ * @param Key - the key being inserted, assigned or removed
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GuardSnapshot(KeyType Key)
+{
+    if(!mSnapshotWriter || mSnapshotWriter->AllCopied())
+        return;
+
+    if(Cuckoo() || DoubleHashing())
+    {
+        GuardSnapshot();
+        return;
+    }
+
+    unsigned index, stride;
+    ProbeStart(Key, Fingerprint(Key), mStats.TableSize_, index, stride);
+
+    unsigned first = index, last = index, walked = 0;
+
+    while(walked < mStats.TableSize_ && mTable[first].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+    {
+        first = first ? first - 1 : mStats.TableSize_ - 1;
+        ++walked;
+    }
+
+    while(walked < mStats.TableSize_ && mTable[last].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+    {
+        last = last + 1 < mStats.TableSize_ ? last + 1 : 0;
+        ++walked;
+    }
+
+    // A cluster that is the whole table
+    if(walked >= mStats.TableSize_)
+        GuardSnapshot();
+    else
+        mSnapshotWriter->CopySlots(first, last);
+}
+
+/**
+ * @brief Has the background snapshot copy every chunk it hasn't yet (so the snapshot is
+ *        finished from memory), before a change to the whole table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GuardSnapshot()
+{
+    if(mSnapshotWriter)
+        mSnapshotWriter->CopyAll();
+}
+
+/**
+ * @brief Starts logging changes to a file
+ * 
+ * @param Path - the log
+ * @param Append - continue an existing log (instead of starting the file over)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OpenLog(const char *Path, bool Append)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Logs need trivially copyable data");
+    static_assert(KeyStorage::SELF_CONTAINED, "Logs need keys that are stored in the slots");
+
+    CloseLog();
+
+    OAHTLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, LogMagic(), sizeof(header.Magic));
+    header.KeySize = sizeof(typename KeyStorage::Stored);
+    header.DataSize = sizeof(T);
+
+    FILE* file = fopen(Path, Append ? "ab+" : "wb");
+    if(!file)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't open the log.");
+
+    // An existing log must be a log of this kind of table, an empty one gets a header
+    OAHTLogHeader existing;
+    bool usable = fseek(file, 0, SEEK_END) == 0;
+    long size = usable ? ftell(file) : -1;
+
+    if(size > 0)
+        usable = fseek(file, 0, SEEK_SET) == 0 && fread(&existing, sizeof(existing), 1, file) == 1 &&
+                 memcmp(&existing, &header, sizeof(header)) == 0 && fseek(file, 0, SEEK_END) == 0;
+    else
+        usable = size == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    if(!usable)
+    {
+        fclose(file);
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't use the log.");
+    }
+
+    mLogBuffer.resize(LOG_BUFFER);
+    setvbuf(file, &mLogBuffer[0], _IOFBF, mLogBuffer.size());
+
+    mLog = file;
+}
+
+/**
+ * @brief Writes out the buffered log records
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FlushLog()
+{
+    if(mLog && (fflush(mLog) != 0 || ferror(mLog)))
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't write the log.");
+}
+
+/**
+ * @brief Writes out the buffered log records and stops logging
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CloseLog()
+{
+    if(!mLog)
+        return;
+
+    FILE* file = mLog;
+    mLog = 0;
+
+    bool failed = ferror(file) != 0;
+    if(fclose(file) != 0 || failed)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't write the log.");
+}
+
+/**
+ * @brief Appends a change to the log. Every record has the same size: the op, the key as the
+ *        slots store it, and the data (zeros for removes and clears).
+ * 
+ * @param Op - the change
+ * @param Key - the key changed
+ * @param Data - the bytes of the new data, or 0
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::LogOp(OAHTLogOp Op, KeyType Key, const void* Data)
+{
+    static const unsigned char none[sizeof(T)] = {0};
+
+    typename KeyStorage::Stored key;
+    memset(&key, 0, sizeof(key));
+    if(Op != LOG_CLEAR)
+        mKeys.Set(key, Key);
+
+    // A failed write leaves the stream's error set for FlushLog and CloseLog
+    fputc(Op, mLog);
+    fwrite(&key, sizeof(key), 1, mLog);
+    fwrite(Data ? Data : none, sizeof(T), 1, mLog);
+}
+
+/**
+ * @brief Applies the records of a log: inserts and assigns become insert_or_assign, removes
+ *        only remove keys that are there
+ * 
+ * @param Path - the log
+ * @return size_t - the number of records applied
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+size_t OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ReplayLog(const char *Path)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Logs need trivially copyable data");
+    static_assert(KeyStorage::SELF_CONTAINED, "Logs need keys that are stored in the slots");
+
+    FILE* file = fopen(Path, "rb");
+    if(!file)
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Can't open the log.");
+
+    OAHTLogHeader header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.Magic, LogMagic(), sizeof(header.Magic)) != 0 ||
+       header.KeySize != sizeof(typename KeyStorage::Stored) || header.DataSize != sizeof(T))
+    {
+        fclose(file);
+        throw OAHashTableException(OAHashTableException::E_SNAPSHOT, "Not a log of this table.");
+    }
+
+    // The changes are already in the log
+    FILE* log = mLog;
+    mLog = 0;
+
+    typename KeyStorage::Stored key;
+    alignas(T) unsigned char data[sizeof(T)];
+    size_t applied = 0;
+    int op;
+
+    try
+    {
+        while((op = fgetc(file)) != EOF && fread(&key, sizeof(key), 1, file) == 1 && fread(data, sizeof(data), 1, file) == 1)
+        {
+            if(op == LOG_INSERT)
+                insert_or_assign(key, *reinterpret_cast<const T*>(data));
+            else if(op == LOG_REMOVE && contains(key))
+                remove(key);
+            else if(op == LOG_CLEAR)
+                clear();
+
+            ++applied;
+        }
+    }
+    catch(...)
+    {
+        mLog = log;
+        fclose(file);
+        throw;
+    }
+
+    mLog = log;
+    fclose(file);
+
+    return applied;
+}
+
+/**
+ * @brief Inserts a copy of the data
+ * 
+ * @param Key - key to insert
+ * @param Data - data to insert
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert(KeyType Key, const T& Data)
+{
+    emplace(Key, Data);
+}
+
+/**
+ * @brief Inserts the data, moving it into the table (it's left alone if the insertion fails)
+ * 
+ * @param Key - key to insert
+ * @param Data - data to insert
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert(KeyType Key, T&& Data)
+{
+    emplace(Key, std::move(Data));
+}
+
+/**
+ * @brief Inserts data constructed in its slot. Throws an exception (E_DUPLICATE) if the key
+ *        is already in the table.
+ * 
+ * @param Key - key to insert
+ * @param args - the arguments of T's constructor
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::emplace(KeyType Key, Args&&... args)
+{
+    if(!try_emplace(Key, std::forward<Args>(args)...))
+        throw OAHashTableException(OAHashTableException::E_DUPLICATE, "Found duplicate item.");
+}
+
+/**
+ * @brief Inserts a copy of the data, unless the key is already in the table
+ * 
+ * @param Key - key to insert
+ * @param Data - data to insert
+ * @return bool - false if the key was already in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::try_insert(KeyType Key, const T& Data)
+{
+    return try_emplace(Key, Data);
+}
+
+/**
+ * @brief Inserts the data by moving it, unless the key is already in the table (the data is
+ *        then left alone)
+ * 
+ * @param Key - key to insert
+ * @param Data - data to insert
+ * @return bool - false if the key was already in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::try_insert(KeyType Key, T&& Data)
+{
+    return try_emplace(Key, std::move(Data));
+}
+
+/**
+ * @brief Grows the table if the load factor is greater than max load factor. Then constructs
+ *        the data in its slot (keys already in the table are found before anything is
+ *        constructed).
+ * 
+ * @param Key - key to insert
+ * @param args - the arguments of T's constructor
+ * @return bool - false if the key was already in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::try_emplace(KeyType Key, Args&&... args)
+{
+    typename TraceHooks::Scope trace(mProbes, TRACE_INSERT, mStats.TableSize_);
+
+    // Keep moving elements out of the old table while resizing
+    if(mOldTable)
+        MigrateSlots(mConfig.ResizeStep_);
+
+    double loadFactor = static_cast<double>(mStats.Count_ + 1) / static_cast<double>(mStats.TableSize_);
+
+    // Grow the table if needed
+    if(loadFactor > mConfig.MaxLoadFactor_)
+    {
+        if(mConfig.IncrementalResize_ && !Cuckoo())
+            BeginIncrementalGrow();
+        else
+            GrowTable();
+    }
+
+    return InsertNew(Key, Fingerprint(Key), std::forward<Args>(args)...);
+}
+
+/**
+ * @brief Inserts a key that fits without the table growing, and logs it
+ * 
+ * @param Key - key to insert
+ * @param fingerprint - Fingerprint(Key)
+ * @param args - the arguments of T's constructor
+ * @return bool - false if the key was already in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::InsertNew(KeyType Key, unsigned fingerprint, Args&&... args)
+{
+    if(!mLog)
+        return PlaceNew(Key, fingerprint, std::forward<Args>(args)...);
+
+    // The log needs the bytes of the data, so it's built before it's placed (logged tables hold
+    // trivially copyable data)
+    T data(std::forward<Args>(args)...);
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, static_cast<const void*>(&data), sizeof(T));
+
+    if(!PlaceNew(Key, fingerprint, std::move(data)))
+        return false;
+
+    LogOp(LOG_INSERT, Key, bytes);
+
+    return true;
+}
+
+/**
+ * @brief Inserts a key that fits without the table growing (the cuckoo policy may still grow
+ *        it when a key can't be placed)
+ * 
+ * @param Key - key to insert
+ * @param fingerprint - Fingerprint(Key)
+ * @param args - the arguments of T's constructor
+ * @return bool - false if the key was already in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::PlaceNew(KeyType Key, unsigned fingerprint, Args&&... args)
+{
+    GuardSnapshot(Key);
+
+    if(Cuckoo())
+    {
+        if(!CuckooInsert(Key, std::forward<Args>(args)...))
+            return false;
+    }
+    else
+    {
+        // Keys that haven't been migrated yet are still in the old table
+        OAHTSlot* slot;
+        if(mOldTable && IndexOfIn(mOldTable, mOldControl, mOldTableSize, Key, slot) != -1)
+            return false;
+
+        // Insert the key/data into the table
+        if(!InsertInTable(mTable, mControl, mStats.TableSize_, Key, fingerprint, std::forward<Args>(args)...))
+            return false;
+    }
+
+    mStats.Count_++;
+
+    // Drop the copies of removed or moved keys once they outweigh the live ones
+    if(mKeys.Wasteful())
+        CompactKeys();
+
+    return true;
+}
+
+/**
+ * @brief Inserts a copy of the data, or replaces the data of the key if it's already in the
+ *        table (the old data goes to the free proc first)
+ * 
+ * @param Key - key to insert
+ * @param Data - data to insert
+ * @return bool - true if the key was inserted, false if its data was replaced
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert_or_assign(KeyType Key, const T& Data)
+{
+    typename TraceHooks::Scope trace(mProbes, TRACE_INSERT, mStats.TableSize_);
+
+    T* data = const_cast<T*>(try_find(Key));
+
+    if(!data)
+        return try_emplace(Key, Data);
+
+    GuardSnapshot(Key);
+
+    if(mConfig.FreeProc_)
+        mConfig.FreeProc_(std::move(*data));
+
+    *data = Data;
+
+    if(mLog)
+        LogOp(LOG_INSERT, Key, data);
+
+    return false;
+}
+
+/**
+ * @brief Inserts the data by moving it, or moves it over the data of the key if it's already
+ *        in the table (the old data goes to the free proc first)
+ * 
+ * @param Key - key to insert
+ * @param Data - data to insert
+ * @return bool - true if the key was inserted, false if its data was replaced
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert_or_assign(KeyType Key, T&& Data)
+{
+    typename TraceHooks::Scope trace(mProbes, TRACE_INSERT, mStats.TableSize_);
+
+    T* data = const_cast<T*>(try_find(Key));
+
+    if(!data)
+        return try_emplace(Key, std::move(Data));
+
+    GuardSnapshot(Key);
+
+    if(mConfig.FreeProc_)
+        mConfig.FreeProc_(std::move(*data));
+
+    *data = std::move(Data);
+
+    if(mLog)
+        LogOp(LOG_INSERT, Key, data);
+
+    return false;
+}
+
+/**
+ * @brief Grows the table to the size that holds Count elements under the max load factor, in
+ *        one rehash. An incremental resize is finished first.
+ * 
+ * @param Count - the number of elements the table should hold
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::reserve(unsigned Count)
+{
+    if(mOldTable)
+        MigrateSlots(mOldTableSize);
+
+    unsigned needed = SlotsToHold(Count, mConfig.MaxLoadFactor_);
+
+    if(needed <= mStats.TableSize_)
+        return;
+
+    if(mConfig.SizingPolicy_ == PRIME_SIZES)
+        needed = GetClosestPrime(needed);
+
+    Rehash(SizeFor(mConfig, needed));
+
+    mStats.Expansions_++;
+}
+
+/**
+ * @brief Shrinks the table to the smallest size that holds its items under the max load
+ *        factor, in one rehash. An incremental resize is finished first.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::shrink_to_fit()
+{
+    if(mOldTable)
+        MigrateSlots(mOldTableSize);
+
+    ShrinkTo(mConfig.MaxLoadFactor_);
+}
+
+/**
+ * @brief Inserts an array of key/data pairs. Reserves room for all of them first, then inserts a
+ *        window at a time without load factor checks, prefetching the home slots of the window
+ *        before inserting it.
+ * 
+ * @param Keys - the keys to insert
+ * @param Data - the data of each key (copied)
+ * @param Count - the number of pairs
+ * @return size_t - the number of keys inserted (keys already in the table are skipped)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+size_t OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert_bulk(const KeyType* Keys, const T* Data, size_t Count)
+{
+    unsigned fingerprints[BATCH_WINDOW];
+    size_t inserted = 0;
+
+    reserve(static_cast<unsigned>(mStats.Count_ + Count));
+
+    for(size_t start = 0; start < Count; start += BATCH_WINDOW)
+    {
+        size_t window = Count - start < BATCH_WINDOW ? Count - start : size_t(BATCH_WINDOW);
+
+        for(size_t i = 0; i < window; ++i)
+        {
+            unsigned index, stride;
+
+            fingerprints[i] = Fingerprint(Keys[start + i]);
+            ProbeStart(Keys[start + i], fingerprints[i], mStats.TableSize_, index, stride);
+            PrefetchProbeStart(Keys[start + i], fingerprints[i], index);
+        }
+
+        for(size_t i = 0; i < window; ++i)
+        {
+            typename TraceHooks::Scope trace(mProbes, TRACE_INSERT, mStats.TableSize_);
+
+            if(InsertNew(Keys[start + i], fingerprints[i], Data[start + i]))
+                ++inserted;
+        }
+    }
+
+    return inserted;
+}
+
+/**
+ * @brief Inserts the key/data pairs of a range (pairs like std::pair<KeyType, T>). Reserves
+ *        room for all of them first, then inserts them without load factor checks.
+ * 
+ * @param First - the first pair
+ * @param Last - one past the last pair
+ * @return size_t - the number of keys inserted (keys already in the table are skipped)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename ForwardIt>
+size_t OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert_bulk(ForwardIt First, ForwardIt Last)
+{
+    size_t inserted = 0;
+
+    reserve(static_cast<unsigned>(mStats.Count_ + std::distance(First, Last)));
+
+    for(; First != Last; ++First)
+    {
+        KeyType key = First->first;
+        typename TraceHooks::Scope trace(mProbes, TRACE_INSERT, mStats.TableSize_);
+
+        if(InsertNew(key, Fingerprint(key), First->second))
+            ++inserted;
+    }
+
+    return inserted;
+}
+
+/**
+ * @brief Removes a slot from the table. Either uses MARK or PACK policy.
+ * 
+ * @param Key - key to remove
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::remove(KeyType Key)
+{
+    typename TraceHooks::Scope trace(mProbes, TRACE_REMOVE, mStats.TableSize_);
+    OAHTSlot* slot;
+
+    GuardSnapshot(Key);
+
+    // Keep moving elements out of the old table while resizing
+    if(mOldTable)
+        MigrateSlots(mConfig.ResizeStep_);
+
+    // Get the index of this key in the table
+    int index = IndexOf(Key, slot);
+
+    // A key that hasn't been migrated yet is still in the old table
+    bool inOldTable = false;
+    if(index == -1 && mOldTable)
+    {
+        index = IndexOfIn(mOldTable, mOldControl, mOldTableSize, Key, slot);
+        inOldTable = index != -1;
+    }
+
+    // Throw an exception if the index doesn't exist
+    if(index == -1)
+    {
+        throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+    }
+     
+    // An element is getting removed
+    mStats.Count_--;
+
+    if(inOldTable)
+    {
+        FreeData(*slot);
+
+        // Marked as deleted, since the old table is only migrated from
+        slot->State = OAHTSlot::OAHTSlot_State::DELETED;
+        SetOccupied(mOldTable, mOldTableSize, index, false);
+        if(mOldControl)
+            SetControl(mOldControl, mOldTableSize, index, CTRL_DELETED);
+    }
+    else if(Cuckoo())
+    {
+        // Use the client-provided free policy on the element
+        FreeData(*slot);
+
+        // No other key's lookup passes through this slot, so it can just be emptied
+        slot->State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+        SetOccupied(mTable, mStats.TableSize_, index, false);
+    }
+    else if(DeletionPolicy() == OAHTDeletionPolicy::BACKWARD_SHIFT)
+    {
+        // Use the client-provided free policy on the element
+        FreeData(*slot);
+
+        // Move the rest of the cluster back over the hole
+        BackwardShift(index);
+    }
+    else if(DeletionPolicy() == OAHTDeletionPolicy::PACK)
+    {
+        // Use the client-provided free policy on the element
+        FreeData(*slot);
+
+        // Set the slot to unoccupied
+        slot->State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+        SetOccupied(mTable, mStats.TableSize_, index, false);
+        if(mControl)
+            SetControl(mControl, mStats.TableSize_, index, CTRL_EMPTY);
+
+        int originalIndex = index;
+        unsigned moved = 0;
+        index++; // Go to the next index
+
+        // Wrap around array if necessary
+        if(static_cast<unsigned>(index) > mStats.TableSize_ - 1)
+        {
+            index = 0;
+        }
+
+        // For every remaining element in the cluster
+        while(mTable[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED && index != originalIndex)
+        {
+            // Take the element out (it may go right back into the same slot)
+            OAHTSlot moving;
+            MoveSlot(moving, mTable[index]);
+
+            // Set the element to unoccupied
+            mTable[index].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+            SetOccupied(mTable, mStats.TableSize_, index, false);
+            if(mControl)
+                SetControl(mControl, mStats.TableSize_, index, CTRL_EMPTY);
+
+            // Re-insert the element into the table
+            InsertInTable(mTable, mControl, mStats.TableSize_, moving.Key, SlotFingerprint(moving), std::move(moving.Data));
+            moving.Data.~T();
+            ++moved;
+
+            index++;
+            
+            // Wrap around array if necessary
+            if(static_cast<unsigned>(index) > mStats.TableSize_ - 1)
+            {
+                index = 0;
+            }
+        }
+
+        TraceHooks::Moved(mProbes, moved);
+
+        // Re-inserted keys were copied again
+        if(mKeys.Wasteful())
+            CompactKeys();
+    }
+    else if(DeletionPolicy() == OAHTDeletionPolicy::MARK)
+    {
+        // Use the client-provided free policy on the element (a tombstone may be
+        // overwritten or dropped by a rehash, so its data can't wait for clear())
+        FreeData(*slot);
+
+        // Simple mark the element as deleted
+        mTable[index].State = OAHTSlot::OAHTSlot_State::DELETED;
+        SetOccupied(mTable, mStats.TableSize_, index, false);
+        if(mControl)
+            SetControl(mControl, mStats.TableSize_, index, CTRL_DELETED);
+
+        mStats.Tombstones_++;
+        PurgeTombstones();
+    }
+
+    // Memory follows the items back down
+    ShrinkIfSparse();
+
+    if(mLog)
+        LogOp(LOG_REMOVE, Key, 0);
+}
+
+/**
+ * @brief Finds an element in the table by key
+ * 
+ * @param Key - the key to search for 
+ * @return const T& - returns the data associated with the key
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+const T& OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::find(KeyType Key) const
+{
+    const T* data = try_find(Key);
+
+    // Throw an exception if the key doesn't exist
+    if(!data)
+        throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Item not found in table.");
+
+    return *data;
+}
+
+/**
+ * @brief Finds an element in the table by key, without throwing
+ * 
+ * @param Key - the key to search for
+ * @return const T* - the data associated with the key, 0 if the key isn't in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+const T* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::try_find(KeyType Key) const
+{
+    typename TraceHooks::Scope trace(mProbes, TRACE_FIND, mStats.TableSize_);
+    OAHTSlot* slot;
+
+    // Get the index of the key (keys not migrated yet are still in the old table)
+    if(IndexOf(Key, slot) == -1 && (!mOldTable || IndexOfIn(mOldTable, mOldControl, mOldTableSize, Key, slot) == -1))
+        return 0;
+
+    return &slot->Data; // Return the found slots data
+}
+
+/**
+ * @brief Returns true if the key is in the table
+ * 
+ * @param Key - the key to search for
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::contains(KeyType Key) const
+{
+    return try_find(Key) != 0;
+}
+
+/**
+ * @brief Finds a batch of keys. Each window of keys is hashed and the slots (and control
+ *        bytes) the lookups start at are prefetched, then the lookups are done in order. Keys
+ *        still in the old table of an incremental resize are looked up there without a
+ *        prefetch.
+ * 
+ * @param Keys - the keys to search for
+ * @param Count - the number of keys
+ * @param Data - set to the data of each key, 0 for keys that aren't in the table
+ * @return size_t - the number of keys found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+size_t OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::find_batch(const KeyType* Keys, size_t Count, const T** Data) const
+{
+    unsigned fingerprints[BATCH_WINDOW], indexes[BATCH_WINDOW], strides[BATCH_WINDOW];
+    size_t found = 0;
+
+    for(size_t start = 0; start < Count; start += BATCH_WINDOW)
+    {
+        size_t window = Count - start < BATCH_WINDOW ? Count - start : size_t(BATCH_WINDOW);
+
+        // Hash the whole window and start loading where each lookup begins
+        for(size_t i = 0; i < window; ++i)
+        {
+            KeyType key = Keys[start + i];
+
+            fingerprints[i] = Fingerprint(key);
+            ProbeStart(key, fingerprints[i], mStats.TableSize_, indexes[i], strides[i]);
+            PrefetchProbeStart(key, fingerprints[i], indexes[i]);
+        }
+
+        // The lookups, mostly from the cache by now
+        for(size_t i = 0; i < window; ++i)
+        {
+            KeyType key = Keys[start + i];
+            OAHTSlot* slot;
+            typename TraceHooks::Scope trace(mProbes, TRACE_FIND, mStats.TableSize_);
+
+            if(IndexOfFrom(mTable, mControl, mStats.TableSize_, key, fingerprints[i], indexes[i], strides[i], slot) == -1 &&
+               (!mOldTable || IndexOfIn(mOldTable, mOldControl, mOldTableSize, key, slot) == -1))
+            {
+                Data[start + i] = 0;
+                continue;
+            }
+
+            Data[start + i] = &slot->Data;
+            ++found;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Finds an element in the table by key and returns a copy of its data
+ * 
+ * @param Key - the key to search for
+ * @param Default - returned if the key isn't in the table
+ * @return T - the data associated with the key, or Default
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+T OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::find_or(KeyType Key, const T& Default) const
+{
+    const T* data = try_find(Key);
+
+    return data ? *data : Default;
+}
+
+#if __cplusplus >= 201703L
+/**
+ * @brief Finds an element in the table by a string view of the key
+ * 
+ * @param Key - the key to search for
+ * @return const T& - returns the data associated with the key
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+const T& OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::find(std::string_view Key) const
+{
+    const T* data = try_find(Key);
+
+    // Throw an exception if the key doesn't exist
+    if(!data)
+        throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Item not found in table.");
+
+    return *data;
+}
+
+/**
+ * @brief Finds an element in the table by a string view of the key, without throwing. The
+ *        hash functions take NUL-terminated keys, so the view is terminated in a buffer on
+ *        the stack (only keys that don't fit, which only the arena stores, go through a
+ *        std::string).
+ * 
+ * @param Key - the key to search for
+ * @return const T* - the data associated with the key, 0 if the key isn't in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+const T* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::try_find(std::string_view Key) const
+{
+    if(Key.size() < MAX_KEYLEN)
+    {
+        char key[MAX_KEYLEN];
+        memcpy(key, Key.data(), Key.size());
+        key[Key.size()] = 0;
+
+        return try_find(static_cast<const char *>(key));
+    }
+
+    return try_find(std::string(Key).c_str());
+}
+#endif
+
+/**
+ * @brief Clears and cleans up the hash table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::clear()
+{
+    GuardSnapshot();
+
+    // Free the elements that haven't been migrated yet, and drop the old table
+    if(mOldTable)
+    {
+        for (unsigned int i = NextOccupied(mOldTable, mOldTableSize, mMigrateIndex); i < mOldTableSize; i = NextOccupied(mOldTable, mOldTableSize, i + 1))
+        {
+            --mStats.Count_;
+
+            FreeData(mOldTable[i]);
+        }
+
+        ReleaseOldTable();
+    }
+
+    if (mStats.Tombstones_ == 0)
+    {
+        // Only the occupied slots need visiting
+        for (unsigned int i = NextOccupied(mTable, mStats.TableSize_, 0); i < mStats.TableSize_; i = NextOccupied(mTable, mStats.TableSize_, i + 1))
+        {
+            --mStats.Count_;
+
+            // Use the free policy to free the data
+            FreeData(mTable[i]);
+
+            // The slot is now unoccupied
+            mTable[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < mStats.TableSize_; ++i)
+        {
+            if (mTable[i].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+            {
+                // Deleted slots were already taken off the count and freed by remove()
+                if(mTable[i].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+                {
+                    --mStats.Count_;
+
+                    // Use the free policy to free the data
+                    FreeData(mTable[i]);
+                }
+
+                // The slot is now unoccupied
+                mTable[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+            }
+        }
+    }
+
+    memset(Occupancy(mTable, mStats.TableSize_), 0, (mStats.TableSize_ + 63) / 64 * sizeof(unsigned long long));
+    mStats.Tombstones_ = 0;
+
+    // No key is stored anymore
+    KeyStorage emptyKeys;
+    mKeys.Swap(emptyKeys);
+
+    // Every control byte is now empty (including the mirrored group)
+    if (mControl)
+        memset(mControl, CTRL_EMPTY, mStats.TableSize_ + OAHTControlGroup::WIDTH);
+
+    if (mLog)
+        LogOp(LOG_CLEAR, KeyType(), 0);
+}
+
+/**
+ * @brief Returns the stats of the hash table.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHTStats OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GetStats() const
+{
+    OAHTStats stats = mStats;
+    stats.Probes_ = mProbes.Total();
+
+    return stats;
+}
+
+/**
+ * @brief Returns the probe counter of the table, which a tracer's records are drained from
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+ProbeCounter& OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GetProbeCounter() const
+{
+    return mProbes;
+}
+
+/**
+ * @brief Builds probe-length histograms from the probes of each slot (see ProbesOf) and
+ *        cluster sizes from runs of non-empty (occupied or deleted) slots. A miss under linear
+ *        probing walks to the end of the cluster, so its length is known for every home
+ *        slot. Under double hashing it depends on the key's stride (and under Robin Hood
+ *        hashing on its distances; cuckoo hashing always looks at both buckets), so it isn't
+ *        reported. During an incremental resize only the new table is analyzed.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHTAnalytics OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GetAnalytics() const
+{
+    OAHTAnalytics analytics;
+    unsigned tableSize = mStats.TableSize_;
+    unsigned items = 0;
+    double probes = 0;
+
+    // A miss walks to the end of the cluster only under plain linear probing
+    bool missesKnown = mConfig.CollisionPolicy_ == PROBE_SEQUENCE && !DoubleHashing();
+
+    for(unsigned i = 0; i < tableSize; ++i)
+    {
+        if(mTable[i].State == OAHTSlot::OAHTSlot_State::DELETED)
+            analytics.Tombstones_++;
+
+        if(mTable[i].State != OAHTSlot::OAHTSlot_State::OCCUPIED)
+            continue;
+
+        unsigned length = ProbesOf(i);
+
+        if(length >= analytics.SuccessfulProbes_.size())
+            analytics.SuccessfulProbes_.resize(length + 1);
+
+        analytics.SuccessfulProbes_[length]++;
+
+        if(length > analytics.LongestProbe_)
+            analytics.LongestProbe_ = length;
+
+        probes += length;
+        items++;
+    }
+
+    if(items)
+        analytics.AverageSuccessful_ = probes / items;
+
+    // Start right after an unoccupied slot so no cluster is split by the wrap
+    unsigned start = 0;
+    while(start < tableSize && mTable[start].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+        ++start;
+
+    // A full table is one cluster, and every miss probes the whole table
+    if(start == tableSize)
+    {
+        analytics.ClusterSizes_.assign(tableSize + 1, 0);
+        analytics.ClusterSizes_[tableSize] = 1;
+        analytics.LongestCluster_ = tableSize;
+
+        if(missesKnown)
+        {
+            analytics.UnsuccessfulProbes_.assign(tableSize + 1, 0);
+            analytics.UnsuccessfulProbes_[tableSize] = tableSize;
+            analytics.AverageUnsuccessful_ = tableSize;
+        }
+
+        return analytics;
+    }
+
+    unsigned run = 0;
+    double missProbes = 0;
+
+    // Walk backwards from the unoccupied slot, so the distance to the end of the cluster is known
+    for(unsigned step = 0; step < tableSize; ++step)
+    {
+        unsigned i = (start + tableSize - step) % tableSize;
+
+        if(mTable[i].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+        {
+            if(run)
+            {
+                if(run >= analytics.ClusterSizes_.size())
+                    analytics.ClusterSizes_.resize(run + 1);
+
+                analytics.ClusterSizes_[run]++;
+
+                if(run > analytics.LongestCluster_)
+                    analytics.LongestCluster_ = run;
+            }
+
+            run = 0;
+        }
+        else
+            run++;
+
+        // A miss starting here probes the rest of the cluster and then the unoccupied slot
+        if(missesKnown)
+        {
+            if(run + 1 >= analytics.UnsuccessfulProbes_.size())
+                analytics.UnsuccessfulProbes_.resize(run + 2);
+
+            analytics.UnsuccessfulProbes_[run + 1]++;
+            missProbes += run + 1;
+        }
+    }
+
+    // The last cluster ends at the slot we started from
+    if(run)
+    {
+        if(run >= analytics.ClusterSizes_.size())
+            analytics.ClusterSizes_.resize(run + 1);
+
+        analytics.ClusterSizes_[run]++;
+
+        if(run > analytics.LongestCluster_)
+            analytics.LongestCluster_ = run;
+    }
+
+    if(missesKnown)
+        analytics.AverageUnsuccessful_ = missProbes / tableSize;
+
+    return analytics;
+}
+
+/**
+ * @brief Returns the probes it takes to find the key of an occupied slot. Slots that don't
+ *        keep them (most fixed policies') only ever use the probe sequence, so the sequence
+ *        is walked from the key's home slot until it reaches the slot.
+ * 
+ * @param index - the occupied slot
+ * @return unsigned - the probes, counted as InsertInTable counts them
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ProbesOf(unsigned index) const
+{
+    if(Policies::SLOT_PROBES)
+        return static_cast<unsigned>(mTable[index].GetProbes());
+
+    unsigned tableSize = mStats.TableSize_;
+    unsigned probe, stride, probes = 1;
+    ProbeStart(mTable[index].Key, SlotFingerprint(mTable[index]), tableSize, probe, stride);
+
+    while(probe != index)
+    {
+        probe += stride;
+
+        // Wrap around the array if needed
+        if(probe > tableSize - 1)
+            probe -= tableSize;
+
+        ++probes;
+    }
+
+    return probes;
+}
+
+/**
+ * @brief Returns a pointer to the hash table.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+const typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OAHTSlot* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GetTable() const
+{
+    return mTable;
+}
+
+/**
+ * @brief Calls a visitor with the key and data of every item in the table.
+ * 
+ * @param Visit - called as Visit(KeyType Key, const T& Data)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename Visitor>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::for_each(Visitor Visit) const
+{
+    // Items the incremental resize hasn't moved yet (moved slots are DELETED)
+    for(unsigned i = NextOccupied(mOldTable, mOldTableSize, 0); mOldTable && i < mOldTableSize; i = NextOccupied(mOldTable, mOldTableSize, i + 1))
+        Visit(static_cast<KeyType>(mOldTable[i].Key), mOldTable[i].Data);
+
+    for(unsigned i = NextOccupied(mTable, mStats.TableSize_, 0); i < mStats.TableSize_; i = NextOccupied(mTable, mStats.TableSize_, i + 1))
+        Visit(static_cast<KeyType>(mTable[i].Key), mTable[i].Data);
+}
+
+/**
+ * @brief Returns an iterator to the first item (of the old table, while an incremental resize
+ *        is moving it)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::const_iterator OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::begin() const
+{
+    const_iterator it;
+    it.mOwner = this;
+    it.mTable = mOldTable ? mOldTable : mTable;
+    it.mIndex = NextOccupied(it.mTable, mOldTable ? mOldTableSize : mStats.TableSize_, 0);
+
+    // An old table with nothing left in it goes straight on to the table
+    if(mOldTable && it.mIndex == mOldTableSize)
+    {
+        it.mTable = mTable;
+        it.mIndex = NextOccupied(mTable, mStats.TableSize_, 0);
+    }
+
+    return it;
+}
+
+/**
+ * @brief Returns the iterator past the last item
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::const_iterator OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::end() const
+{
+    const_iterator it;
+    it.mOwner = this;
+    it.mTable = mTable;
+    it.mIndex = mStats.TableSize_;
+
+    return it;
+}
+
+/**
+ * @brief Moves an iterator to the next item, from the old table on to the table
+ * 
+ * @param it - the iterator (not at the end)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Advance(const_iterator& it) const
+{
+    if(it.mTable == mOldTable)
+    {
+        it.mIndex = NextOccupied(mOldTable, mOldTableSize, it.mIndex + 1);
+        if(it.mIndex < mOldTableSize)
+            return;
+
+        it.mTable = mTable;
+        it.mIndex = NextOccupied(mTable, mStats.TableSize_, 0);
+        return;
+    }
+
+    it.mIndex = NextOccupied(mTable, mStats.TableSize_, it.mIndex + 1);
+}
+
+/**
+ * @brief Inserts into a given table. This function assumes there will be room in the table.
+ * 
+ * @param table - the table to insert pair in
+ * @param control - the table's control bytes (0 when using SLOT_STATE)
+ * @param tableSize - the size of the table
+ * @param Key - the key to insert
+ * @param fingerprint - the key's fingerprint
+ * @param args - the arguments of T's constructor
+ * @return bool - false if the key is already in the table (nothing is constructed)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::InsertInTable(OAHTSlot* table, unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, Args&&... args)
+{
+    unsigned index, stride, probes = 0;
+
+    // Get the index and the stride/increment
+    ProbeStart(Key, fingerprint, tableSize, index, stride);
+
+    if (RobinHood())
+        return RobinHoodInsert(table, tableSize, Key, fingerprint, index, std::forward<Args>(args)...);
+
+    unsigned home = index;
+    unsigned char fragment = Fragment(fingerprint);
+
+    if (UseGroupProbing(control, tableSize))
+    {
+        // Linear probing a whole group of control bytes at a time
+        int groupIndex = GroupInsertIndex(table, control, tableSize, index, fingerprint, Key);
+
+        if (groupIndex == -1)
+            return false;
+
+        index = static_cast<unsigned>(groupIndex);
+    }
+    else if (control)
+    {
+        // Search the control bytes for an open spot, only comparing keys whose fragment matches
+        while (!(control[index] & CTRL_EMPTY))
+        {
+            // Stop if there's a duplicate
+            if (control[index] == fragment && KeyMatches(table[index], fingerprint, Key))
+            {
+                mProbes.Add(probes);
+                return false;
+            }
+
+            index += stride; // Go to the next index by stride
+
+            // Wrap around the array if needed
+            if (index > tableSize - 1)
+            {
+                index -= tableSize;
+            }
+
+            ++probes;
+        }
+    }
+    else
+    {
+        // Search for an open spot in the array
+        while (table[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+        {
+            // Stop if there's a duplicate
+            if (KeyMatches(table[index], fingerprint, Key))
+            {
+                mProbes.Add(probes);
+                return false;
+            }
+
+            index += stride; // Go to the next index by stride
+
+            // Wrap around the array if needed
+            if (index > tableSize - 1)
+            {
+                index -= tableSize;
+            }
+
+            ++probes;
+        }
+    }
+
+    // Steps taken from the home slot (the group probe only tells us where it stopped)
+    unsigned distance = probes;
+    if (UseGroupProbing(control, tableSize))
+        distance = index >= home ? index - home : index + tableSize - home;
+
+    if (!UseGroupProbing(control, tableSize))
+    {
+        // If the slot that was inserted into was a deleted slot, check for duplicates
+        if (table[index].State == OAHTSlot::OAHTSlot_State::DELETED && DeletionPolicy() == OAHTDeletionPolicy::MARK)
+        {
+            if (CheckForMarkInsertionDuplicate(index, stride, table, control, tableSize, Key, fingerprint, probes))
+                return false;
+        }
+
+        ++probes;
+        mProbes.Add(probes);
+    }
+
+    // A reused tombstone is no longer one
+    bool tombstone = table[index].State == OAHTSlot::OAHTSlot_State::DELETED;
+
+    // Construct the data in the slot, which is now occupied
+    FillSlot(table[index], Key, fingerprint, std::forward<Args>(args)...);
+    table[index].SetProbes(static_cast<int>(distance) + 1);
+    SetOccupied(table, tableSize, index, true);
+
+    if (tombstone)
+        mStats.Tombstones_--;
+    if (control)
+        SetControl(control, tableSize, index, fragment);
+
+    return true;
+}
+
+/**
+ * @brief Stores the key and constructs the data in a slot, which becomes occupied. If T's
+ *        constructor throws, the slot keeps its state.
+ * 
+ * @param slot - the slot (its data isn't constructed)
+ * @param Key - the key
+ * @param fingerprint - the key's fingerprint
+ * @param args - the arguments of T's constructor
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FillSlot(OAHTSlot& slot, KeyType Key, unsigned fingerprint, Args&&... args)
+{
+    mKeys.Set(slot.Key, Key);
+    new (&slot.Data) T(std::forward<Args>(args)...);
+
+    slot.SetHash(fingerprint);
+    slot.State = OAHTSlot::OAHTSlot_State::OCCUPIED;
+}
+
+/**
+ * @brief Moves an element into a slot whose data isn't constructed. The data left behind is
+ *        destroyed, and the key is moved as it is (it stays in the same key storage).
+ * 
+ * @param to - the slot to move to
+ * @param from - the occupied slot to move from (the caller sets its state)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::MoveSlot(OAHTSlot& to, OAHTSlot& from)
+{
+    new (&to.Data) T(std::move(from.Data));
+    from.Data.~T();
+
+    memcpy(&to.Key, &from.Key, sizeof(to.Key));
+    static_cast<typename OAHTSlot::Extras&>(to) = from;
+    to.State = OAHTSlot::OAHTSlot_State::OCCUPIED;
+}
+
+/**
+ * @brief Swaps two occupied slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SwapSlots(OAHTSlot& a, OAHTSlot& b)
+{
+    using std::swap;
+
+    swap(a.Data, b.Data);
+    swap(a.Key, b.Key);
+    swap(static_cast<typename OAHTSlot::Extras&>(a), static_cast<typename OAHTSlot::Extras&>(b));
+}
+
+/**
+ * @brief Uses the client-provided free proc on an element's data (moving the data into it,
+ *        since the data is destroyed right after), then destroys it
+ * 
+ * @param slot - the occupied slot (the caller sets its state)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FreeData(OAHTSlot& slot) const
+{
+    if(mConfig.FreeProc_)
+        mConfig.FreeProc_(std::move(slot.Data));
+
+    slot.Data.~T();
+}
+
+/**
+ * @brief Calculates the size the table grows to
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GrownTableSize() const
+{
+    double factor = std::ceil(mStats.TableSize_ * mConfig.GrowthFactor_);
+
+    // Sizes stop at the largest 32-bit value
+    if(factor > 4294967295.0)
+        factor = 4294967295.0;
+
+    if(mConfig.SizingPolicy_ == POWER_OF_TWO_SIZES)
+        return SizeFor(mConfig, static_cast<unsigned>(factor) > mStats.TableSize_ ? static_cast<unsigned>(factor) : mStats.TableSize_ + 1);
+
+    return SizeFor(mConfig, GetClosestPrime(static_cast<unsigned>(factor)));
+}
+
+/**
+ * @brief Grows the table (should only be called when load factor is past max load factor)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GrowTable()
+{
+    Rehash(GrownTableSize());
+
+    mStats.Expansions_++;
+}
+
+/**
+ * @brief Moves every element into a new table, leaving the tombstones behind
+ * 
+ * @param newTableSize - the size of the new table (may be the current size)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Rehash(unsigned newTableSize)
+{
+    GuardSnapshot();
+
+    // Allocate the new table
+    OAHTSlot* newTable = AllocateSlots(newTableSize);
+
+    unsigned char* newControl = AllocateControl(newTableSize);
+
+    // The keys are copied into new key storage, which drops the dead copies (the old
+    // storage lives until the end of this function)
+    KeyStorage oldKeys;
+    oldKeys.Swap(mKeys);
+
+    // Large tables are moved by several threads when they can be
+    CacheModulo(newTableSize);
+    bool parallel = RehashInParallel(newTable, newControl, newTableSize);
+
+    // Insert every slot in old table into new table
+    for(unsigned int i = 0; !parallel && i < mStats.TableSize_; ++i)
+    {
+        if(mTable[i].State != OAHTSlot::OAHTSlot_State::OCCUPIED)
+            continue;
+
+        if(Cuckoo())
+        {
+            // The keys are copied once every element has a slot
+            OAHTSlot carried;
+            MoveSlot(carried, mTable[i]);
+            mTable[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+            SetOccupied(mTable, mStats.TableSize_, i, false);
+
+            // Some element has no slot even in the new table, so start over with a bigger one
+            if(!CuckooPlace(newTable, newTableSize, carried))
+            {
+                CuckooReturn(newTable, newTableSize, carried);
+
+                FreeSlots(newTable, newTableSize);
+                FreeControl(newControl, newTableSize);
+
+                // The table still points at the old storage
+                mKeys.Swap(oldKeys);
+
+                Rehash(SizeFor(mConfig, newTableSize * 2));
+                return;
+            }
+        }
+        else
+        {
+            InsertInTable(newTable, newControl, newTableSize, mTable[i].Key, SlotFingerprint(mTable[i]), std::move(mTable[i].Data));
+            mTable[i].Data.~T();
+        }
+    }
+
+    // Delete the old table
+    ReleaseTable(mTable, mControl, mStats.TableSize_);
+
+    // Set table to the new table
+    mTable = newTable;
+    mControl = newControl;
+
+    // Keys still waiting in the table of an incremental resize (and the keys moved by cuckoo hashing)
+    if(Cuckoo())
+        StoreKeysAgain(mTable, newTableSize);
+    StoreKeysAgain(mOldTable, mOldTableSize);
+    mKeys.Rebuilt();
+
+    mStats.TableSize_ = newTableSize;
+    mStats.Tombstones_ = 0;
+}
+
+/**
+ * @brief Moves every element into a new table with RehashThreads_ threads, each taking a range
+ *        of the old slots. An element goes in the first slot of its probe sequence that no
+ *        thread has claimed yet, so every slot before it on the sequence is occupied, as
+ *        lookups expect (the order elements arrive in doesn't matter). An element can land in
+ *        another slot than the serial rehash gives it. Under linear probing the same slots
+ *        are filled and the probe total is the same, but under double hashing both depend
+ *        on the order. Robin Hood and cuckoo placement move other elements, and other key
+ *        storage isn't safe to share, so those are left to the serial loop.
+ * 
+ * @param newTable - the new table
+ * @param newControl - its control bytes (0 when using SLOT_STATE)
+ * @param newTableSize - its size
+ * @return bool - false if the table should be rehashed serially (nothing was moved)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::RehashInParallel(OAHTSlot* newTable, unsigned char* newControl, unsigned newTableSize)
+{
+    if(!KeyStorage::SELF_CONTAINED || !std::is_nothrow_move_constructible<T>::value || RobinHood() || Cuckoo())
+        return false;
+
+    unsigned threads = mConfig.RehashThreads_ ? mConfig.RehashThreads_ : std::thread::hardware_concurrency();
+
+    // Each thread gets at least REHASH_SHARE slots
+    if(threads > mStats.TableSize_ / REHASH_SHARE)
+        threads = mStats.TableSize_ / REHASH_SHARE;
+
+    if(threads < 2)
+        return false;
+
+    // A slot is taken by whichever thread first sets its claim (value-initialized to 0)
+    std::vector<std::atomic<unsigned char> > claims(newTableSize);
+    std::vector<unsigned> probes(threads, 0);
+    std::vector<std::thread> workers;
+
+    // If threads can't be started, the ranges left over run on this thread
+    unsigned started = 1;
+    try
+    {
+        workers.reserve(threads - 1);
+
+        for(; started < threads; ++started)
+        {
+            unsigned begin = static_cast<unsigned>(static_cast<unsigned long long>(mStats.TableSize_) * started / threads);
+            unsigned end = static_cast<unsigned>(static_cast<unsigned long long>(mStats.TableSize_) * (started + 1) / threads);
+
+            workers.emplace_back(&OAHashTable::RehashRange, this, newTable, newControl, newTableSize, &claims[0], begin, end, &probes[started]);
+        }
+    }
+    catch(...)
+    {
+    }
+
+    unsigned end = static_cast<unsigned>(static_cast<unsigned long long>(mStats.TableSize_) / threads);
+    RehashRange(newTable, newControl, newTableSize, &claims[0], 0, end, &probes[0]);
+
+    if(started < threads)
+    {
+        unsigned begin = static_cast<unsigned>(static_cast<unsigned long long>(mStats.TableSize_) * started / threads);
+        RehashRange(newTable, newControl, newTableSize, &claims[0], begin, mStats.TableSize_, &probes[0]);
+    }
+
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    // The threads would share bitmap words, so the claims become the new table's bitmap here
+    unsigned long long* occupied = Occupancy(newTable, newTableSize);
+
+    for(unsigned i = 0; i < newTableSize; ++i)
+    {
+        if(claims[i].load(std::memory_order_relaxed))
+            occupied[i / 64] |= 1ull << (i % 64);
+    }
+
+    unsigned total = 0;
+    for(size_t i = 0; i < probes.size(); ++i)
+        total += probes[i];
+    mProbes.Add(total);
+
+    return true;
+}
+
+/**
+ * @brief Moves the elements of a range of the old slots into the new table (one thread of
+ *        RehashInParallel). The keys are unique, so nothing is compared.
+ * 
+ * @param newTable - the new table
+ * @param newControl - its control bytes (0 when using SLOT_STATE)
+ * @param newTableSize - its size
+ * @param claims - a flag per new slot, set by the thread that takes the slot
+ * @param begin - the first old slot
+ * @param end - one past the last old slot
+ * @param probes - the probes taken are added to it, counted as InsertInTable counts them
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::RehashRange(OAHTSlot* newTable, unsigned char* newControl, unsigned newTableSize,
+                                                                                std::atomic<unsigned char>* claims, unsigned begin, unsigned end, unsigned* probes)
+{
+    unsigned total = 0;
+
+    for(unsigned i = begin; i < end; ++i)
+    {
+        if(mTable[i].State != OAHTSlot::OAHTSlot_State::OCCUPIED)
+            continue;
+
+        unsigned fingerprint = SlotFingerprint(mTable[i]);
+        unsigned index, stride, distance = 0;
+        ProbeStart(mTable[i].Key, fingerprint, newTableSize, index, stride);
+
+        // Looking before claiming keeps the claimed cache lines from bouncing between threads
+        while(claims[index].load(std::memory_order_relaxed) || claims[index].exchange(1, std::memory_order_relaxed))
+        {
+            index += stride;
+
+            // Wrap around the array if needed
+            if(index > newTableSize - 1)
+                index -= newTableSize;
+
+            ++distance;
+        }
+
+        // The key is copied as it is (it's stored in the slot), the cached hash goes with it
+        MoveSlot(newTable[index], mTable[i]);
+        newTable[index].SetHash(fingerprint);
+        newTable[index].SetProbes(static_cast<int>(distance) + 1);
+
+        if(newControl)
+            SetControl(newControl, newTableSize, index, Fragment(fingerprint));
+
+        total += distance + 1;
+    }
+
+    *probes += total;
+}
+
+/**
+ * @brief Rehashes the table at the same size once tombstones pass MaxTombstoneFactor_ of the
+ *        slots. Lookups walk over tombstones, so under churn they would otherwise keep getting
+ *        slower until the next growth.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::PurgeTombstones()
+{
+    if(mConfig.MaxTombstoneFactor_ <= 0 || mStats.Tombstones_ == 0)
+        return;
+
+    if(static_cast<double>(mStats.Tombstones_) / static_cast<double>(mStats.TableSize_) > mConfig.MaxTombstoneFactor_)
+        Rehash(mStats.TableSize_);
+}
+
+/**
+ * @brief Returns the number of slots that holds a number of items under a load factor
+ * 
+ * @param Count - the number of items
+ * @param LoadFactor - the load factor not to pass
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SlotsToHold(unsigned Count, double LoadFactor)
+{
+    unsigned needed = static_cast<unsigned>(std::ceil(Count / LoadFactor));
+
+    // The last of the Count inserts must not see a load factor past it
+    while(static_cast<double>(Count) / static_cast<double>(needed) > LoadFactor)
+        ++needed;
+
+    return needed;
+}
+
+/**
+ * @brief Rehashes the table down to the size that holds its items at a load factor, but no
+ *        smaller than the initial table size
+ * 
+ * @param LoadFactor - the load factor the items should be at
+ * @return bool - false if the table was already that small (nothing was done)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ShrinkTo(double LoadFactor)
+{
+    unsigned needed = SlotsToHold(mStats.Count_, LoadFactor);
+
+    if(needed < mConfig.InitialTableSize_)
+        needed = mConfig.InitialTableSize_;
+
+    if(mConfig.SizingPolicy_ == PRIME_SIZES)
+        needed = GetClosestPrime(needed);
+
+    needed = SizeFor(mConfig, needed);
+
+    if(needed >= mStats.TableSize_)
+        return false;
+
+    Rehash(needed);
+
+    mStats.Shrinks_++;
+
+    return true;
+}
+
+/**
+ * @brief Shrinks the table once a remove leaves its load factor under MinLoadFactor_. It's
+ *        sized halfway between the min and max load factors, so that either resize is a
+ *        number of operations away proportional to the table's size and the table can't
+ *        thrash between growing and shrinking.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ShrinkIfSparse()
+{
+    // Not while an incremental resize is moving elements into the table
+    if(mConfig.MinLoadFactor_ <= 0 || mOldTable)
+        return;
+
+    if(static_cast<double>(mStats.Count_) / static_cast<double>(mStats.TableSize_) >= mConfig.MinLoadFactor_)
+        return;
+
+    ShrinkTo((mConfig.MinLoadFactor_ + mConfig.MaxLoadFactor_) / 2);
+}
+
+/**
+ * @brief Starts growing the table incrementally. The current table becomes the old table and
+ *        insert/remove move ResizeStep_ of its slots into the grown table each call.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::BeginIncrementalGrow()
+{
+    GuardSnapshot();
+
+    // The table filled up again before the last resize finished
+    if(mOldTable)
+        MigrateSlots(mOldTableSize);
+
+    unsigned newTableSize = GrownTableSize();
+
+    // Allocate the new table
+    OAHTSlot* newTable = AllocateSlots(newTableSize);
+
+    // The current table is migrated from now on
+    mOldTable = mTable;
+    mOldControl = mControl;
+    mOldTableSize = mStats.TableSize_;
+    mMigrateIndex = 0;
+
+    mTable = newTable;
+    mControl = AllocateControl(newTableSize);
+
+    mStats.TableSize_ = newTableSize;
+    mStats.Tombstones_ = 0;
+    mStats.Expansions_++;
+    CacheModulo(newTableSize);
+}
+
+/**
+ * @brief Moves the occupied slots among the next count slots of the old table into the
+ *        current table. Releases the old table when every slot has been moved.
+ * 
+ * @param count - the number of old slots to visit
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::MigrateSlots(unsigned count)
+{
+    unsigned end = mOldTableSize - mMigrateIndex > count ? mMigrateIndex + count : mOldTableSize;
+
+    for(; mMigrateIndex < end; ++mMigrateIndex)
+    {
+        OAHTSlot& slot = mOldTable[mMigrateIndex];
+
+        if(slot.State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+        {
+            InsertInTable(mTable, mControl, mStats.TableSize_, slot.Key, SlotFingerprint(slot), std::move(slot.Data));
+            slot.Data.~T();
+
+            // Keep the old probe chains intact for the keys still waiting
+            slot.State = OAHTSlot::OAHTSlot_State::DELETED;
+            SetOccupied(mOldTable, mOldTableSize, mMigrateIndex, false);
+            if(mOldControl)
+                SetControl(mOldControl, mOldTableSize, mMigrateIndex, CTRL_DELETED);
+        }
+    }
+
+    if(mMigrateIndex == mOldTableSize)
+        ReleaseOldTable();
+}
+
+/**
+ * @brief Deletes the old table (its elements must have been moved or freed)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ReleaseOldTable()
+{
+    ReleaseTable(mOldTable, mOldControl, mOldTableSize);
+
+    mOldTable = 0;
+    mOldControl = 0;
+    mOldTableSize = 0;
+    mMigrateIndex = 0;
+}
+
+/**
+ * @brief Returns the table size used for a requested size. Prime sizing uses the requested
+ *        size as is (GrowTable picks primes), power of two sizing rounds it up.
+ * 
+ * @param Config - the table's config
+ * @param requested - the requested size
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SizeFor(const OAHTConfig& Config, unsigned requested)
+{
+    if(Config.SizingPolicy_ == POWER_OF_TWO_SIZES)
+        requested = GetNextPowerOfTwo(requested);
+
+    // Cuckoo hashing needs whole buckets, and two of them
+    if(!Policies::FIXED && Config.CollisionPolicy_ == CUCKOO)
+    {
+        if(requested < 2 * CUCKOO_WAYS)
+            requested = 2 * CUCKOO_WAYS;
+
+        requested = (requested + CUCKOO_WAYS - 1) / CUCKOO_WAYS * CUCKOO_WAYS;
+    }
+
+    return requested;
+}
+
+/**
+ * @brief Finds the index of a key in the hash table
+ * 
+ * @param Key - key to find
+ * @param Slot - sets this to the found slot
+ * @return int - returns the index of the slot, -1 if not found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::IndexOf(KeyType Key, OAHTSlot* &Slot) const
+{
+    return IndexOfIn(mTable, mControl, mStats.TableSize_, Key, Slot);
+}
+
+/**
+ * @brief Finds the index of a key in a given table
+ * 
+ * @param table - the table to search
+ * @param control - the table's control bytes (0 when using SLOT_STATE)
+ * @param tableSize - the table size
+ * @param Key - key to find
+ * @param Slot - sets this to the found slot
+ * @return int - returns the index of the slot, -1 if not found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::IndexOfIn(OAHTSlot* table, const unsigned char* control, unsigned tableSize, KeyType Key, OAHTSlot* &Slot) const
+{
+    unsigned fingerprint = Fingerprint(Key);
+    unsigned index, stride;
+
+    // Get the index and the stride/increment
+    ProbeStart(Key, fingerprint, tableSize, index, stride);
+
+    return IndexOfFrom(table, control, tableSize, Key, fingerprint, index, stride, Slot);
+}
+
+/**
+ * @brief Finds the index of a key in a given table, once the key is hashed
+ * 
+ * @param table - the table to search
+ * @param control - the table's control bytes (0 when using SLOT_STATE)
+ * @param tableSize - the table size
+ * @param Key - key to find
+ * @param fingerprint - the key's fingerprint
+ * @param index - the key's home index (from ProbeStart)
+ * @param stride - the key's stride (from ProbeStart)
+ * @param Slot - sets this to the found slot
+ * @return int - returns the index of the slot, -1 if not found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::IndexOfFrom(OAHTSlot* table, const unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, unsigned stride, OAHTSlot* &Slot) const
+{
+    unsigned probes = 0;
+    unsigned originalIndex = index;
+
+    if(Cuckoo())
+        return CuckooIndexOf(table, tableSize, Key, fingerprint, Slot);
+
+    if(RobinHood())
+        return RobinHoodIndexOf(table, tableSize, Key, fingerprint, index, Slot);
+
+    if(UseGroupProbing(control, tableSize))
+        return IndexOfGroup(table, control, tableSize, Key, fingerprint, index, Slot);
+
+    if(control)
+    {
+        unsigned char fragment = Fragment(fingerprint);
+
+        if(control[index] == CTRL_EMPTY)
+            ++probes;
+
+        // Walk the control bytes with stride until an empty slot is found. Only slots
+        // whose fragment matches are loaded from the table.
+        while(control[index] != CTRL_EMPTY)
+        {
+            ++probes;
+
+            // If this is the slot, return
+            if(control[index] == fragment && KeyMatches(table[index], fingerprint, Key))
+            {
+                Slot = &table[index];
+                mProbes.Add(probes);
+
+                return index;
+            }
+
+            index += stride;
+
+            // Wrap around the array if needed
+            if(index > tableSize - 1)
+            {
+                index -= tableSize;
+            }
+
+            if(control[index] == CTRL_EMPTY)
+                ++probes;
+
+            // Stop if it has come back to the original index
+            if(index == originalIndex)
+            {
+                break;
+            }
+        }
+
+        mProbes.Add(probes);
+
+        return -1;
+    }
+
+    if(table[index].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+        ++probes;
+
+    // Walk the table with stride until an unoccupied slot is found
+    while(table[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED || table[index].State == OAHTSlot::OAHTSlot_State::DELETED)
+    {
+        ++probes;
+
+        // If this is the slot, return (deleted slots still hold their old key)
+        if(table[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED && KeyMatches(table[index], fingerprint, Key))
+        {
+            Slot = &table[index];
+            mProbes.Add(probes);
+
+            return index;
+        }
+
+        index += stride;
+
+        // Wrap around the array if needed
+        if(static_cast<unsigned>(index) > tableSize - 1)
+        {
+            index -= tableSize;
+        }
+
+        if(table[index].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+            ++probes;
+
+        // Stop if it has come back to the original index
+        if(index == originalIndex)
+        {
+            break;
+        }
+    }
+
+    mProbes.Add(probes);
+
+    // If an unoccupied slot was found, the key is not in the array
+    return -1;
+}
+
+/**
+ * @brief Prints the array, debug purposes
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::PrintTable(OAHTSlot* table, unsigned tableSize) const
+{
+    for(unsigned i = 0; i < tableSize; ++i)
+    {
+        if(table[i].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+            std::cout << "Index " << i << ": " << "unoccupied";
+        else
+            std::cout << "Index " << i << ": " << static_cast<KeyType>(table[i].Key);
+
+        std::cout << std::endl;
+    }
+
+    std::cout << std::endl;
+}
+
+/**
+ * @brief Checks for a duplicate item after a slot marked as deleted was inserted into.
+ * 
+ * @param index - index of inserted slot
+ * @param stride - stride
  * @param table - the table to check
+ * @param control - the table's control bytes (0 when using SLOT_STATE)
+ * @param tableSize - the table size
+ * @param Key - the key that was inserted
+ * @param fingerprint - the key's fingerprint
+ * @param probes - the insertion's probe count so far, added to
+ * @return bool - true if the key is already in the table (its probes are then counted)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CheckForMarkInsertionDuplicate(unsigned index, unsigned stride, OAHTSlot* table, unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned& probes)
+{
+    unsigned duplicateCheckIndex = index + stride; // Go to the next index with stride
+
+    // Wrap around the array if needed
+    if (duplicateCheckIndex > tableSize - 1)
+    {
+        duplicateCheckIndex -= tableSize;
+    }
+
+    unsigned char fragment = Fragment(fingerprint);
+
+    // Walk through the table with stride until an unoccupied slot is found
+    while (control ? control[duplicateCheckIndex] != CTRL_EMPTY : table[duplicateCheckIndex].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+    {
+        ++probes;
+
+        // Deleted slots still hold their old key, so only occupied slots are compared
+        bool candidate = control ? control[duplicateCheckIndex] == fragment : table[duplicateCheckIndex].State == OAHTSlot::OAHTSlot_State::OCCUPIED;
+
+        // Stop if any duplicates are found
+        if (candidate && KeyMatches(table[duplicateCheckIndex], fingerprint, Key))
+        {
+            mProbes.Add(probes);
+            return true;
+        }
+
+        // Go to the next index with stride
+        duplicateCheckIndex += stride;
+
+        // Wrap around the array if needed
+        if (duplicateCheckIndex > tableSize - 1)
+        {
+            duplicateCheckIndex -= tableSize;
+        }
+
+        // Stop if it has come back to the inserted slot (no unoccupied slots left)
+        if (duplicateCheckIndex == index)
+        {
+            break;
+        }
+    }
+
+    ++probes;
+
+    return false;
+}
+
+/**
+ * @brief Allocates the control bytes for a table, all marked empty
+ * 
+ * @param tableSize - the size of the table
+ * @return unsigned char* - the control bytes, 0 unless the layout is CONTROL_BYTES
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned char* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::AllocateControl(unsigned tableSize) const
+{
+    // Robin Hood and cuckoo hashing work from the slots, so they don't use control bytes
+    if (mConfig.LayoutPolicy_ != CONTROL_BYTES || mConfig.CollisionPolicy_ != PROBE_SEQUENCE)
+        return 0;
+
+    unsigned char* control = static_cast<unsigned char*>(Allocator::Allocate(tableSize + OAHTControlGroup::WIDTH));
+    memset(control, CTRL_EMPTY, tableSize + OAHTControlGroup::WIDTH);
+
+    return control;
+}
+
+/**
+ * @brief Gives control bytes from AllocateControl back to the allocator
+ * 
+ * @param control - the control bytes (may be 0)
+ * @param tableSize - the size of their table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FreeControl(unsigned char* control, unsigned tableSize) const
+{
+    if (control)
+        Allocator::Free(control, tableSize + OAHTControlGroup::WIDTH);
+}
+
+/**
+ * @brief Frees a table and its control bytes. The table of a snapshot isn't the allocator's,
+ *        so the snapshot is unmapped instead (its elements must have been moved or freed).
+ * 
+ * @param table - the slots
+ * @param control - the table's control bytes (may be 0)
+ * @param tableSize - the number of slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ReleaseTable(OAHTSlot* table, unsigned char* control, unsigned tableSize)
+{
+    char* bytes = reinterpret_cast<char*>(table);
+
+    if(mSnapshot && bytes >= mSnapshot && bytes < mSnapshot + mSnapshotBytes)
+    {
+        UnmapFile(mSnapshot, mSnapshotBytes);
+
+        mSnapshot = 0;
+        mSnapshotBytes = 0;
+        return;
+    }
+
+    FreeSlots(table, tableSize);
+    FreeControl(control, tableSize);
+}
+
+/**
+ * @brief The settings a snapshot has to be loaded with that aren't policies
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SnapshotFlags() const
+{
+    unsigned flags = 0;
+
+    if(mConfig.CacheHashes_)
+        flags |= SNAPSHOT_CACHE_HASHES;
+    if(DoubleHashing())
+        flags |= SNAPSHOT_DOUBLE_HASHING;
+
+    return flags;
+}
+
+/**
+ * @brief Hashes the probe starts of the first occupied slot around each sixteenth of the
+ *        table. Another primary, secondary or full-width hash function changes where those
+ *        keys start, and so the identity.
+ * 
+ * @return unsigned - the identity of the hash functions
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::HashIdentity() const
+{
+    unsigned identity = 2166136261u;
+
+    for(unsigned sample = 0; sample < SNAPSHOT_SAMPLES; ++sample)
+    {
+        unsigned i = static_cast<unsigned>(static_cast<unsigned long long>(mStats.TableSize_) * sample / SNAPSHOT_SAMPLES);
+        unsigned end = mStats.TableSize_ - i > SNAPSHOT_SCAN ? i + SNAPSHOT_SCAN : mStats.TableSize_;
+
+        // A sparse stretch is skipped rather than read through (that would fault its pages in)
+        while(i < end && mTable[i].State != OAHTSlot::OAHTSlot_State::OCCUPIED)
+            ++i;
+
+        if(i == end)
+            continue;
+
+        unsigned fingerprint = Fingerprint(mTable[i].Key);
+        unsigned index, stride;
+
+        if(Cuckoo())
+            CuckooBuckets(mTable[i].Key, fingerprint, mStats.TableSize_, index, stride);
+        else
+            ProbeStart(mTable[i].Key, fingerprint, mStats.TableSize_, index, stride);
+
+        unsigned values[4] = {i, fingerprint, index, stride};
+
+        for(unsigned v = 0; v < 4; ++v)
+            identity = (identity ^ values[v]) * 16777619u;
+    }
+
+    return identity;
+}
+
+/**
+ * @brief Allocates a table from the allocator, with every slot unoccupied
+ * 
+ * @param tableSize - the number of slots
+ * @return OAHTSlot* - the slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OAHTSlot* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::AllocateSlots(unsigned tableSize)
+{
+    OAHTSlot* table = static_cast<OAHTSlot*>(Allocator::Allocate(SlotBytes(tableSize)));
+
+    // Set all slots in the table to unoccupied
+    for(unsigned int i = 0; i < tableSize; ++i)
+    {
+        new (&table[i]) OAHTSlot;
+        table[i].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+    }
+
+    // And none of them in the bitmap
+    memset(Occupancy(table, tableSize), 0, (tableSize + 63) / 64 * sizeof(unsigned long long));
+
+    return table;
+}
+
+/**
+ * @brief Gives a table from AllocateSlots back to the allocator (its data must have been
+ *        destroyed already)
+ * 
+ * @param table - the slots (may be 0)
+ * @param tableSize - the number of slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FreeSlots(OAHTSlot* table, unsigned tableSize)
+{
+    if (!table)
+        return;
+
+    for(unsigned int i = 0; i < tableSize; ++i)
+        table[i].~OAHTSlot();
+
+    Allocator::Free(table, SlotBytes(tableSize));
+}
+
+/**
+ * @brief The bytes of a table's allocation: the slots, then the occupancy bitmap on an 8 byte
+ *        boundary
+ * 
+ * @param tableSize - the number of slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+std::size_t OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SlotBytes(unsigned tableSize)
+{
+    std::size_t slotBytes = (sizeof(OAHTSlot) * static_cast<std::size_t>(tableSize) + 7) / 8 * 8;
+
+    return slotBytes + (static_cast<std::size_t>(tableSize) + 63) / 64 * sizeof(unsigned long long);
+}
+
+/**
+ * @brief Returns the occupancy bitmap that follows a table's slots
+ * 
+ * @param table - the slots
+ * @param tableSize - the number of slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned long long* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Occupancy(OAHTSlot* table, unsigned tableSize)
+{
+    std::size_t slotBytes = (sizeof(OAHTSlot) * static_cast<std::size_t>(tableSize) + 7) / 8 * 8;
+
+    return reinterpret_cast<unsigned long long*>(reinterpret_cast<char*>(table) + slotBytes);
+}
+
+/**
+ * @brief Returns the occupancy bitmap that follows a table's slots
+ * 
+ * @param table - the slots
+ * @param tableSize - the number of slots
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+const unsigned long long* OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Occupancy(const OAHTSlot* table, unsigned tableSize)
+{
+    return Occupancy(const_cast<OAHTSlot*>(table), tableSize);
+}
+
+/**
+ * @brief Sets or clears a slot's bit in the occupancy bitmap
+ * 
+ * @param table - the slots
+ * @param tableSize - the number of slots
+ * @param index - the slot
+ * @param occupied - whether the slot is now OCCUPIED
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SetOccupied(OAHTSlot* table, unsigned tableSize, unsigned index, bool occupied)
+{
+    unsigned long long& word = Occupancy(table, tableSize)[index / 64];
+    unsigned long long bit = 1ull << (index % 64);
+
+    if(occupied)
+        word |= bit;
+    else
+        word &= ~bit;
+}
+
+/**
+ * @brief Finds the first occupied slot at or after an index, a bitmap word at a time
+ * 
+ * @param table - the slots
+ * @param tableSize - the number of slots
+ * @param index - the slot to start at
+ * @return unsigned - the occupied slot, tableSize if there are no more
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::NextOccupied(const OAHTSlot* table, unsigned tableSize, unsigned index)
+{
+    if(index >= tableSize)
+        return tableSize;
+
+    const unsigned long long* occupied = Occupancy(table, tableSize);
+    unsigned words = (tableSize + 63) / 64;
+    unsigned w = index / 64;
+
+    // The slots before the index don't count
+    unsigned long long word = occupied[w] & (~0ull << (index % 64));
+
+    while(!word)
+    {
+        if(++w == words)
+            return tableSize;
+
+        word = occupied[w];
+    }
+
+    return w * 64 + LowestBit(word);
+}
+
+/**
+ * @brief Index of the lowest set bit (Word must not be 0)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::LowestBit(unsigned long long Word)
+{
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(Word));
+#else
+    unsigned bit = 0;
+    while (!(Word & 1))
+    {
+        Word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+/**
+ * @brief Sets a control byte, keeping the mirrored first group in sync
+ * 
+ * @param control - the control bytes
+ * @param tableSize - the size of the table
+ * @param index - index of the slot
+ * @param value - the new control byte
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SetControl(unsigned char* control, unsigned tableSize, unsigned index, unsigned char value)
+{
+    control[index] = value;
+
+    if (index < OAHTControlGroup::WIDTH)
+        control[tableSize + index] = value;
+}
+
+/**
+ * @brief Returns the fragment stored in the control byte of an occupied slot. The home slot
+ *        takes the low bits of the fingerprint, which reach the top 7 in a power of two table
+ *        of 2^25 slots, so the fragment comes from the fingerprint remixed instead (with
+ *        another multiplier than the stride's and the shards').
+ * 
+ * @param fingerprint - the key's fingerprint
+ * @return unsigned char - the top 7 bits of the remixed fingerprint
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned char OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Fragment(unsigned fingerprint)
+{
+    return static_cast<unsigned char>((fingerprint * 0x85EBCA6Bu) >> 25);
+}
+
+/**
+ * @brief Computes a key's fingerprint, if anything in the table uses it. With a full-width
+ *        hash function the fingerprint is that hash folded to 32 bits.
+ * 
+ * @param Key - the key
+ * @return unsigned - the fingerprint (0 when nothing in the table uses it)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Fingerprint(KeyType Key) const
+{
+    if (HasFullHash())
+    {
+        unsigned long long hash = FullHash(Key);
+        return static_cast<unsigned>(hash ^ (hash >> 32));
+    }
+
+    // Cuckoo hashing without a secondary hash function derives the second bucket from it
+    bool cuckooBucket = Cuckoo() && !mConfig.SecondaryHashFunc_;
+
+    if (mConfig.LayoutPolicy_ != CONTROL_BYTES && !mConfig.CacheHashes_ && !cuckooBucket)
+        return 0;
+
+    return KeyStorage::Fingerprint(Key);
+}
+
+/**
+ * @brief Prefetches where a probe of the current table starts
+ * 
+ * @param Key - the key
+ * @param fingerprint - the key's fingerprint
+ * @param index - the key's home index (from ProbeStart)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::PrefetchProbeStart(KeyType Key, unsigned fingerprint, unsigned index) const
+{
+    if(Cuckoo())
+    {
+        unsigned first, second;
+        CuckooBuckets(Key, fingerprint, mStats.TableSize_, first, second);
+
+        OAHTPrefetch(&mTable[first * CUCKOO_WAYS]);
+        OAHTPrefetch(&mTable[second * CUCKOO_WAYS]);
+        return;
+    }
+
+    if(mControl)
+        OAHTPrefetch(&mControl[index]);
+
+    OAHTPrefetch(&mTable[index]);
+}
+
+/**
+ * @brief Computes where a key's probe sequence starts and its stride. With a full-width hash
+ *        function both come from the fingerprint, otherwise from the client HASHFUNCs.
+ * 
+ * @param Key - the key
+ * @param fingerprint - the key's fingerprint
+ * @param tableSize - the table size
+ * @param index - set to the key's home index
+ * @param stride - set to the stride (1 for linear probing)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ProbeStart(KeyType Key, unsigned fingerprint, unsigned tableSize, unsigned& index, unsigned& stride) const
+{
+    stride = 1;
+
+    bool powerOfTwo = mConfig.SizingPolicy_ == POWER_OF_TWO_SIZES;
+
+    if (HasFullHash())
+    {
+        // Power of two sizes just mask off the low bits
+        index = powerOfTwo ? fingerprint & (tableSize - 1) : Remainder(fingerprint, tableSize);
+
+        // Rotate and remix so the stride doesn't follow the index
+        if (DoubleHashing())
+        {
+            unsigned mixed = ((fingerprint << 16) | (fingerprint >> 16)) * 0x9E3779B1u;
+
+            // An odd stride visits every slot of a power of two table
+            stride = powerOfTwo ? (mixed & (tableSize - 1)) | 1 : Remainder(mixed, tableSize - 1) + 1;
+        }
+
+        return;
+    }
+
+    // Get the index with the primary hash function
+    index = mConfig.PrimaryHashFunc_(Key, tableSize);
+
+    // If we are doing double hashing, get the stride/increment
+    if (DoubleHashing())
+    {
+        stride = mConfig.SecondaryHashFunc_(Key, tableSize - 1) + 1;
+
+        // An odd stride visits every slot of a power of two table
+        if (powerOfTwo)
+            stride |= 1;
+    }
+}
+
+/**
+ * @brief Computes Value % Divisor, with the multiplies of a cached FastModulo when there is one
+ *        for the divisor
+ * 
+ * @param Value - the dividend
+ * @param Divisor - the divisor (a table size, one less, or a number of cuckoo buckets)
+ * @return unsigned - the remainder
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Remainder(unsigned Value, unsigned Divisor) const
+{
+    if (Divisor == mIndexModulo.Divisor)
+        return mIndexModulo(Value);
+
+    if (Divisor == mStrideModulo.Divisor)
+        return mStrideModulo(Value);
+
+    if (Divisor == mBucketModulo.Divisor)
+        return mBucketModulo(Value);
+
+    return Value % Divisor;
+}
+
+/**
+ * @brief Prepares the remainders ProbeStart and CuckooBuckets take for a table size (the old
+ *        table of an incremental resize divides)
+ * 
+ * @param tableSize - the size of the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CacheModulo(unsigned tableSize)
+{
+    mIndexModulo = FastModulo(tableSize);
+    mStrideModulo = FastModulo(tableSize > 1 ? tableSize - 1 : 1);
+    mBucketModulo = FastModulo(tableSize >= CUCKOO_WAYS ? tableSize / CUCKOO_WAYS : 1);
+}
+
+/**
+ * @brief Whether collisions are resolved with double hashing (vs. linear probing)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::DoubleHashing() const
+{
+    if (Policies::FIXED)
+        return Policies::PROBING == DOUBLE_HASHING;
+
+    // Robin Hood hashing always probes linearly
+    if (RobinHood())
+        return false;
+
+    return mConfig.SecondaryHashFunc_ || (mConfig.FullHashFunc_ && mConfig.DoubleHashing_);
+}
+
+/**
+ * @brief Whether keys are hashed with a full-width hash (always under a fixed policy)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::HasFullHash() const
+{
+    return Policies::FIXED || mConfig.FullHashFunc_;
+}
+
+/**
+ * @brief Hashes a key with the full-width hash of the policy or the config
+ * 
+ * @param Key - the key
+ * @return unsigned long long - the hash
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned long long OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FullHash(KeyType Key) const
+{
+    if (Policies::FIXED)
+        return typename Policies::Hash()(Key);
+
+    return mConfig.FullHashFunc_(Key);
+}
+
+/**
+ * @brief The deletion policy of the policy or the config. PACK and BACKWARD_SHIFT are MARK
+ *        under double hashing: a key's probe sequence can pass through any slot, so no run of
+ *        slots after a hole holds every key that has to move back over it.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHTDeletionPolicy OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::DeletionPolicy() const
+{
+    OAHTDeletionPolicy policy = Policies::FIXED ? Policies::DELETION : mConfig.DeletionPolicy_;
+
+    if (policy != OAHTDeletionPolicy::MARK && DoubleHashing())
+        return OAHTDeletionPolicy::MARK;
+
+    return policy;
+}
+
+/**
+ * @brief Returns the fingerprint of an occupied slot's key, without rehashing it when hashes are cached
+ * 
+ * @param slot - the slot
+ * @return unsigned - the fingerprint
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::SlotFingerprint(const OAHTSlot& slot) const
+{
+    if (mConfig.CacheHashes_)
+        return slot.GetHash();
+
+    return Fingerprint(slot.Key);
+}
+
+/**
+ * @brief Checks if an occupied slot holds a key. With cached hashes the keys are only
+ *        compared when the hashes match.
+ * 
+ * @param slot - the slot
+ * @param fingerprint - the key's fingerprint
+ * @param Key - the key
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::KeyMatches(const OAHTSlot& slot, unsigned fingerprint, KeyType Key) const
+{
+    if (mConfig.CacheHashes_ && slot.GetHash() != fingerprint)
+        return false;
+
+    return KeyStorage::Equal(slot.Key, Key);
+}
+
+/**
+ * @brief Whether a table is probed a group of control bytes at a time. This needs the
+ *        CONTROL_BYTES layout, linear probing, and a table of at least one group.
+ * 
+ * @param control - the table's control bytes
+ * @param tableSize - the table size
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::UseGroupProbing(const unsigned char* control, unsigned tableSize) const
+{
+    return control && !DoubleHashing() && tableSize >= OAHTControlGroup::WIDTH;
+}
+
+/**
+ * @brief Finds the index of a key by linear probing the control bytes a group at a time.
+ *        Counts the same probes as walking the slots one at a time.
+ * 
+ * @param table - the table to search
+ * @param control - the table's control bytes
+ * @param tableSize - the table size
+ * @param Key - key to find
+ * @param fingerprint - the key's fingerprint
+ * @param index - the key's home index
+ * @param Slot - sets this to the found slot
+ * @return int - returns the index of the slot, -1 if not found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::IndexOfGroup(OAHTSlot* table, const unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, OAHTSlot* &Slot) const
+{
+    unsigned char fragment = Fragment(fingerprint);
+
+    // Walk the table a group at a time until a group with an empty slot is found
+    for(unsigned scanned = 0; scanned < tableSize; scanned += OAHTControlGroup::WIDTH)
+    {
+        const unsigned char* group = control + index;
+
+        // Only the slots up to the first empty one (that haven't been seen yet) are in the probe sequence
+        unsigned limit = tableSize - scanned;
+        unsigned empty = OAHTControlGroup::Match(group, CTRL_EMPTY);
+        if(empty && OAHTControlGroup::LowestBit(empty) < limit)
+            limit = OAHTControlGroup::LowestBit(empty);
+
+        unsigned matches = OAHTControlGroup::Match(group, fragment) & OAHTControlGroup::LowBits(limit);
+
+        // Compare the keys of the slots whose fragment matches
+        while(matches)
+        {
+            unsigned bit = OAHTControlGroup::LowestBit(matches);
+            unsigned slotIndex = index + bit;
+
+            // Wrap around the array if needed
+            if(slotIndex > tableSize - 1)
+                slotIndex -= tableSize;
+
+            if(KeyMatches(table[slotIndex], fingerprint, Key))
+            {
+                mProbes.Add(scanned + bit + 1);
+                Slot = &table[slotIndex];
+
+                return slotIndex;
+            }
+
+            matches &= matches - 1;
+        }
+
+        // The key isn't in the table if an empty slot was found
+        if(limit < OAHTControlGroup::WIDTH && scanned + limit < tableSize)
+        {
+            mProbes.Add(scanned + limit + 1);
+
+            return -1;
+        }
+
+        index += OAHTControlGroup::WIDTH;
+
+        // Wrap around the array if needed
+        if(index > tableSize - 1)
+            index -= tableSize;
+    }
+
+    // Every slot was visited
+    mProbes.Add(tableSize);
+
+    return -1;
+}
+
+/**
+ * @brief Finds where to insert a key by linear probing the control bytes a group at a time. Counts
+ *        the same probes as walking the slots one at a time (including the MARK duplicate check).
+ * 
+ * @param table - the table to insert in
+ * @param control - the table's control bytes
  * @param tableSize - the table size
- * @param Key - the key that was inserted
+ * @param index - the key's home index
+ * @param fingerprint - the key's fingerprint
+ * @param Key - the key to insert
+ * @return int - the index of the first free (empty or deleted) slot, -1 if the key is already
+ *               in the table
  */
-template<typename T>
-void OAHashTable<T>::CheckForMarkInsertionDuplicate(unsigned index, unsigned stride, OAHTSlot* table, unsigned tableSize, const char* Key)
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GroupInsertIndex(OAHTSlot* table, const unsigned char* control, unsigned tableSize, unsigned index, unsigned fingerprint, KeyType Key)
 {
-    unsigned duplicateCheckIndex = index + stride; // Go to the next index with stride
+    unsigned char fragment = Fragment(fingerprint);
+    unsigned insertDistance = tableSize;
+    unsigned insertIndex = index;
 
-    // Walk through the table with stride until an unoccupied slot is found
-    while (table[duplicateCheckIndex].State == OAHTSlot::OAHTSlot_State::DELETED || table[duplicateCheckIndex].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+    // Every occupied slot up to the first empty one has to be checked for a duplicate
+    // (deleted slots can only exist with MARK, which continues past them)
+    for(unsigned scanned = 0; scanned < tableSize; scanned += OAHTControlGroup::WIDTH)
     {
-        ++mStats.Probes_;
+        const unsigned char* group = control + index;
+
+        unsigned limit = tableSize - scanned;
+        unsigned empty = OAHTControlGroup::Match(group, CTRL_EMPTY);
+        if(empty && OAHTControlGroup::LowestBit(empty) < limit)
+            limit = OAHTControlGroup::LowestBit(empty);
 
-        // If any duplicates are found, throw an exception
-        if (strcmp(table[duplicateCheckIndex].Key, Key) == 0)
+        // Remember the first empty or deleted slot
+        unsigned free = OAHTControlGroup::MatchHighBit(group) & OAHTControlGroup::LowBits(limit + 1);
+        if(insertDistance == tableSize && free)
         {
-            throw OAHashTableException(OAHashTableException::E_DUPLICATE, "Found duplicate item.");
+            insertDistance = scanned + OAHTControlGroup::LowestBit(free);
+            insertIndex = index + OAHTControlGroup::LowestBit(free);
+
+            // Wrap around the array if needed
+            if(insertIndex > tableSize - 1)
+                insertIndex -= tableSize;
         }
 
-        // Go to the next index with stride
-        duplicateCheckIndex += stride;
+        unsigned matches = OAHTControlGroup::Match(group, fragment) & OAHTControlGroup::LowBits(limit);
+
+        while(matches)
+        {
+            unsigned bit = OAHTControlGroup::LowestBit(matches);
+            unsigned slotIndex = index + bit;
+
+            // Wrap around the array if needed
+            if(slotIndex > tableSize - 1)
+                slotIndex -= tableSize;
+
+            // Stop if there's a duplicate
+            if(KeyMatches(table[slotIndex], fingerprint, Key))
+            {
+                mProbes.Add(scanned + bit);
+                return -1;
+            }
+
+            matches &= matches - 1;
+        }
+
+        // Stop at the first empty slot
+        if(limit < OAHTControlGroup::WIDTH && scanned + limit < tableSize)
+        {
+            mProbes.Add(scanned + limit + 1);
+
+            return static_cast<int>(insertIndex);
+        }
+
+        index += OAHTControlGroup::WIDTH;
 
         // Wrap around the array if needed
-        if (duplicateCheckIndex > tableSize - 1)
+        if(index > tableSize - 1)
+            index -= tableSize;
+    }
+
+    // There are no empty slots, so the walk ends at the first deleted one
+    mProbes.Add(insertDistance + 1);
+
+    return static_cast<int>(insertIndex);
+}
+
+/**
+ * @brief Returns true if the table uses Robin Hood hashing
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::RobinHood() const
+{
+    return !Policies::FIXED && mConfig.CollisionPolicy_ == ROBIN_HOOD;
+}
+
+/**
+ * @brief Inserts with Robin Hood hashing. Walking from the home slot, the element being
+ *        placed takes the slot of the first element closer to its own home, which then
+ *        continues the walk. The key can't be further along once that happens, so the
+ *        duplicate check stops there. Tombstones keep their distance, so they are only
+ *        taken over the same way.
+ * 
+ * @param table - the table to insert into
+ * @param tableSize - the size of the table
+ * @param Key - the key to insert
+ * @param fingerprint - the key's fingerprint
+ * @param index - the key's home slot
+ * @param args - the arguments of T's constructor
+ * @return bool - false if the key is already in the table (nothing is constructed)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::RobinHoodInsert(OAHTSlot* table, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, Args&&... args)
+{
+    // The element being placed: the new one (only constructed once it displaces an
+    // element, since the key may turn out to be a duplicate), then whichever one it displaced
+    OAHTSlot carried;
+    carried.SetProbes(1);
+
+    bool checkDuplicates = true;
+    bool tombstone = false;
+    unsigned probes = 1, moved = 0;
+
+    for(;;)
+    {
+        OAHTSlot& slot = table[index];
+
+        if(slot.State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+            break;
+
+        // Stop if there's a duplicate
+        if(checkDuplicates && slot.State == OAHTSlot::OAHTSlot_State::OCCUPIED && KeyMatches(slot, fingerprint, Key))
         {
-            duplicateCheckIndex -= tableSize;
+            mProbes.Add(probes);
+            return false;
+        }
+
+        // This slot is closer to its home, so it gives it up
+        if(slot.GetProbes() < carried.GetProbes())
+        {
+            if(slot.State == OAHTSlot::OAHTSlot_State::DELETED)
+            {
+                tombstone = true;
+                break;
+            }
+
+            if(checkDuplicates)
+                FillSlot(carried, Key, fingerprint, std::forward<Args>(args)...);
+
+            SwapSlots(slot, carried);
+            ++moved;
+            checkDuplicates = false;
+        }
+
+        // Go to the next slot, one further from home
+        index++;
+        carried.SetProbes(carried.GetProbes() + 1);
+
+        // Wrap around the array if needed
+        if(index > tableSize - 1)
+            index = 0;
+
+        ++probes;
+    }
+
+    mProbes.Add(probes);
+    TraceHooks::Moved(mProbes, moved);
+
+    int distance = carried.GetProbes();
+
+    if(checkDuplicates)
+        FillSlot(table[index], Key, fingerprint, std::forward<Args>(args)...);
+    else
+        MoveSlot(table[index], carried);
+
+    table[index].SetProbes(distance);
+    SetOccupied(table, tableSize, index, true);
+
+    if(tombstone)
+        mStats.Tombstones_--;
+
+    return true;
+}
+
+/**
+ * @brief Finds a key under Robin Hood hashing. The search ends at an unoccupied slot or at
+ *        a slot closer to its home than the key would be at that point.
+ * 
+ * @param table - the table to search
+ * @param tableSize - the table size
+ * @param Key - key to find
+ * @param fingerprint - the key's fingerprint
+ * @param index - the key's home slot
+ * @param Slot - sets this to the found slot
+ * @return int - returns the index of the slot, -1 if not found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::RobinHoodIndexOf(OAHTSlot* table, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, OAHTSlot* &Slot) const
+{
+    for(unsigned probes = 1; probes <= tableSize; ++probes)
+    {
+        const OAHTSlot& slot = table[index];
+
+        if(slot.State == OAHTSlot::OAHTSlot_State::UNOCCUPIED || static_cast<unsigned>(slot.GetProbes()) < probes)
+        {
+            mProbes.Add(probes);
+
+            return -1;
+        }
+
+        // If this is the slot, return (deleted slots still hold their old key)
+        if(slot.State == OAHTSlot::OAHTSlot_State::OCCUPIED && KeyMatches(slot, fingerprint, Key))
+        {
+            Slot = &table[index];
+            mProbes.Add(probes);
+
+            return index;
+        }
+
+        index++;
+
+        // Wrap around the array if needed
+        if(index > tableSize - 1)
+            index = 0;
+    }
+
+    mProbes.Add(tableSize);
+
+    return -1;
+}
+
+/**
+ * @brief Removes the element at a slot by moving the rest of its cluster back (Knuth's
+ *        algorithm R). An element can fill the hole unless its home slot is between the
+ *        hole and itself; the slot it leaves is the next hole. No keys are rehashed or
+ *        compared. Under Robin Hood hashing the cluster is shifted by one until an element
+ *        that's already home.
+ * 
+ * @param hole - the slot of the removed element
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::BackwardShift(unsigned hole)
+{
+    unsigned tableSize = mStats.TableSize_;
+    unsigned index = hole + 1, moved = 0;
+
+    // Wrap around the array if needed
+    if(index > tableSize - 1)
+        index = 0;
+
+    while(mTable[index].State != OAHTSlot::OAHTSlot_State::UNOCCUPIED && index != hole)
+    {
+        OAHTSlot& slot = mTable[index];
+        unsigned distance = static_cast<unsigned>(slot.GetProbes()) - 1;
+        unsigned gap = index >= hole ? index - hole : index + tableSize - hole;
+
+        // Every element after one that's home is home or further along (Robin Hood)
+        if(RobinHood() && distance == 0)
+            break;
+
+        if(slot.State == OAHTSlot::OAHTSlot_State::OCCUPIED && distance >= gap)
+        {
+            // Move the element into the hole, which is now closer to its home
+            MoveSlot(mTable[hole], slot);
+            mTable[hole].SetProbes(mTable[hole].GetProbes() - static_cast<int>(gap));
+            SetOccupied(mTable, tableSize, hole, true);
+            if(mControl)
+                SetControl(mControl, tableSize, hole, mControl[index]);
+
+            hole = index;
+            ++moved;
+        }
+
+        index++;
+
+        // Wrap around the array if needed
+        if(index > tableSize - 1)
+            index = 0;
+    }
+
+    TraceHooks::Moved(mProbes, moved);
+
+    // The last slot moved out of (or the removed one) is now unoccupied
+    mTable[hole].State = OAHTSlot::OAHTSlot_State::UNOCCUPIED;
+    SetOccupied(mTable, tableSize, hole, false);
+    if(mControl)
+        SetControl(mControl, tableSize, hole, CTRL_EMPTY);
+}
+
+/**
+ * @brief Returns true if the table uses cuckoo hashing
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::Cuckoo() const
+{
+    return !Policies::FIXED && mConfig.CollisionPolicy_ == CUCKOO;
+}
+
+/**
+ * @brief Gets the two buckets a key can live in. The first comes from the primary hash
+ *        function (or the full-width hash), the second from the secondary hash function
+ *        (or a remix of the fingerprint). The two are always different.
+ * 
+ * @param Key - the key
+ * @param fingerprint - the key's fingerprint
+ * @param tableSize - the size of the table (a multiple of CUCKOO_WAYS)
+ * @param first - set to the first bucket
+ * @param second - set to the second bucket
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CuckooBuckets(KeyType Key, unsigned fingerprint, unsigned tableSize, unsigned& first, unsigned& second) const
+{
+    unsigned buckets = tableSize / CUCKOO_WAYS;
+    unsigned mixed = ((fingerprint << 16) | (fingerprint >> 16)) * 0x9E3779B1u;
+
+    if (HasFullHash())
+        first = Remainder(fingerprint, buckets);
+    else
+        first = mConfig.PrimaryHashFunc_(Key, buckets);
+
+    if (mConfig.SecondaryHashFunc_)
+        second = mConfig.SecondaryHashFunc_(Key, buckets);
+    else
+        second = Remainder(mixed, buckets);
+
+    if (second == first)
+        second = first + 1 < buckets ? first + 1 : 0;
+}
+
+/**
+ * @brief Inserts under cuckoo hashing, growing the table until the displacement chain
+ *        finds room.
+ * 
+ * @param Key - the key to insert
+ * @param args - the arguments of T's constructor
+ * @return bool - false if the key is already in the table (nothing is constructed)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CuckooInsert(KeyType Key, Args&&... args)
+{
+    OAHTSlot* slot;
+
+    // Stop if there's a duplicate (it can only be in the key's two buckets)
+    if(IndexOf(Key, slot) != -1)
+        return false;
+
+    OAHTSlot carried;
+    FillSlot(carried, Key, Fingerprint(Key), std::forward<Args>(args)...);
+
+    // A chain that ran too long leaves the last displaced element without a slot
+    while(!CuckooPlace(mTable, mStats.TableSize_, carried))
+    {
+        // Growing rebuilds the key storage, and the element isn't in the table
+        KeyStorage heldKeys;
+        typename KeyStorage::Stored held;
+        heldKeys.Set(held, carried.Key);
+
+        GrowTable();
+        mKeys.Set(carried.Key, held);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Places an element in one of its buckets, displacing elements to their other
+ *        bucket while both are full.
+ * 
+ * @param table - the table to place the element in
+ * @param tableSize - the size of the table
+ * @param carried - the element (on failure, the element that was left without a slot)
+ * @return bool - false if the displacement chain passed CUCKOO_MAX_KICKS
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CuckooPlace(OAHTSlot* table, unsigned tableSize, OAHTSlot& carried)
+{
+    unsigned first, second, probes = 0;
+    CuckooBuckets(carried.Key, SlotFingerprint(carried), tableSize, first, second);
+
+    // Take an empty slot in either bucket
+    int way = CuckooEmptyWay(table, first, probes);
+    unsigned bucket = first;
+
+    if(way == -1)
+    {
+        way = CuckooEmptyWay(table, second, probes);
+        bucket = second;
+    }
+
+    // Both are full, so displace an element of the first bucket to its other bucket, and so on
+    if(way == -1)
+    {
+        bucket = first;
+
+        for(unsigned kick = 0; kick < CUCKOO_MAX_KICKS && way == -1; ++kick)
+        {
+            // A different way each time, so two elements don't keep displacing each other
+            unsigned victimWay = kick % CUCKOO_WAYS;
+            OAHTSlot& victim = table[bucket * CUCKOO_WAYS + victimWay];
+
+            carried.SetProbes(static_cast<int>((bucket == first ? 0 : CUCKOO_WAYS) + victimWay + 1));
+            SwapSlots(victim, carried);
+
+            // The displaced element can only go to its other bucket
+            CuckooBuckets(carried.Key, SlotFingerprint(carried), tableSize, first, second);
+            bucket = bucket == first ? second : first;
+
+            way = CuckooEmptyWay(table, bucket, probes);
+            TraceHooks::Moved(mProbes, 1);
+        }
+    }
+
+    mProbes.Add(probes);
+
+    if(way == -1)
+        return false;
+
+    // Probes a find takes: the slots up to it, across the first bucket too
+    carried.SetProbes(static_cast<int>((bucket == first ? 0 : CUCKOO_WAYS) + way + 1));
+    MoveSlot(table[bucket * CUCKOO_WAYS + way], carried);
+    SetOccupied(table, tableSize, bucket * CUCKOO_WAYS + way, true);
+
+    return true;
+}
+
+/**
+ * @brief Moves the elements of an abandoned cuckoo rehash back into the table, so it can
+ *        start over. Every element moved out of the table left an unoccupied slot, so there
+ *        is room for all of them (where they go doesn't matter, the table is rehashed next).
+ * 
+ * @param newTable - the abandoned table
+ * @param newTableSize - its size
+ * @param carried - the element that was left without a slot
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CuckooReturn(OAHTSlot* newTable, unsigned newTableSize, OAHTSlot& carried)
+{
+    unsigned index = 0;
+
+    for(unsigned i = 0; i <= newTableSize; ++i)
+    {
+        OAHTSlot& slot = i < newTableSize ? newTable[i] : carried;
+
+        if(i < newTableSize && slot.State != OAHTSlot::OAHTSlot_State::OCCUPIED)
+            continue;
+
+        while(mTable[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+            ++index;
+
+        MoveSlot(mTable[index], slot);
+        SetOccupied(mTable, mStats.TableSize_, index, true);
+    }
+}
+
+/**
+ * @brief Finds an unoccupied slot in a bucket
+ * 
+ * @param table - the table
+ * @param bucket - the bucket to look in
+ * @param probes - incremented for every slot looked at
+ * @return int - the slot's way in the bucket, -1 if the bucket is full
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CuckooEmptyWay(const OAHTSlot* table, unsigned bucket, unsigned& probes) const
+{
+    for(unsigned way = 0; way < CUCKOO_WAYS; ++way)
+    {
+        ++probes;
+
+        if(table[bucket * CUCKOO_WAYS + way].State == OAHTSlot::OAHTSlot_State::UNOCCUPIED)
+            return static_cast<int>(way);
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Finds a key under cuckoo hashing by looking at its two buckets
+ * 
+ * @param table - the table to search
+ * @param tableSize - the table size
+ * @param Key - key to find
+ * @param fingerprint - the key's fingerprint
+ * @param Slot - sets this to the found slot
+ * @return int - returns the index of the slot, -1 if not found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+int OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CuckooIndexOf(OAHTSlot* table, unsigned tableSize, KeyType Key, unsigned fingerprint, OAHTSlot* &Slot) const
+{
+    unsigned buckets[2];
+    CuckooBuckets(Key, fingerprint, tableSize, buckets[0], buckets[1]);
+
+    unsigned probes = 0;
+
+    for(unsigned i = 0; i < 2; ++i)
+    {
+        for(unsigned way = 0; way < CUCKOO_WAYS; ++way)
+        {
+            unsigned index = buckets[i] * CUCKOO_WAYS + way;
+
+            ++probes;
+
+            if(table[index].State == OAHTSlot::OAHTSlot_State::OCCUPIED && KeyMatches(table[index], fingerprint, Key))
+            {
+                Slot = &table[index];
+                mProbes.Add(probes);
+
+                return static_cast<int>(index);
+            }
         }
     }
 
-    ++mStats.Probes_;
+    mProbes.Add(probes);
+
+    return -1;
+}
+
+/**
+ * @brief Copies every live key into new key storage and frees the old one
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::CompactKeys()
+{
+    KeyStorage oldKeys;
+    oldKeys.Swap(mKeys);
+
+    StoreKeysAgain(mTable, mStats.TableSize_);
+    StoreKeysAgain(mOldTable, mOldTableSize);
+
+    mKeys.Rebuilt();
+}
+
+/**
+ * @brief Copies the keys of a table into the current key storage, after it was swapped for
+ *        a new one. Deleted slots get an empty key, since their old copy is about to go.
+ * 
+ * @param table - the table (may be 0)
+ * @param tableSize - the size of the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::StoreKeysAgain(OAHTSlot* table, unsigned tableSize)
+{
+    for(unsigned i = 0; table && i < tableSize; ++i)
+    {
+        if(table[i].State == OAHTSlot::OAHTSlot_State::OCCUPIED)
+            mKeys.Set(table[i].Key, table[i].Key);
+        else if(table[i].State == OAHTSlot::OAHTSlot_State::DELETED)
+            memset(&table[i].Key, 0, sizeof(table[i].Key));
+    }
 }
@@ -3,7 +3,7 @@
  * @author Adam Lonstein (adam.lonstein@digipen.com)
  * @brief This implements a hash table. The hash table can use both linear probing and double hashing
  *        collision resolutions. The hash table can use both MARK and PACK deletion policies. The hashing
- *        function(s) must be client-provided.
+ *        function(s) can be client-provided (HashKey of Support.h by default).
  * @date 04-12-2024
  */
 
@@ -11,15 +11,45 @@
 #ifndef OAHASHTABLEH
 #define OAHASHTABLEH
 //---------------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 #include "Support.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 /*!
 client-provided hash function: takes a key and table size,
 returns an index in the table.
 */
 typedef unsigned (*HASHFUNC)(const char *, unsigned);
 
+/*!
+client-provided full-width hash function: takes a key, returns a hash
+that doesn't depend on the table size. The table derives the index and
+the double hashing stride from it, so each key is hashed once.
+*/
+typedef unsigned long long (*FULLHASHFUNC)(const char *);
+
 //! Max length of our "string" keys
 const unsigned MAX_KEYLEN = 32;
 
@@ -43,7 +73,7 @@ class OAHashTableException
       Retrieves exception code
 
       \return
-        One of: E_ITEM_NOT_FOUND, E_DUPLICATE, E_NO_MEMORY
+        One of: E_ITEM_NOT_FOUND, E_DUPLICATE, E_NO_MEMORY, E_SNAPSHOT
     */
     virtual int code() const { 
       return error_code_; 
@@ -59,118 +89,1309 @@ class OAHashTableException
       return message_.c_str();
     }
     //! Possible exception conditions
-    enum OAHASHTABLE_EXCEPTION {E_ITEM_NOT_FOUND, E_DUPLICATE, E_NO_MEMORY};
+    enum OAHASHTABLE_EXCEPTION {E_ITEM_NOT_FOUND, E_DUPLICATE, E_NO_MEMORY, E_SNAPSHOT};
 };
 
-//! The policy used during a deletion
-enum OAHTDeletionPolicy {MARK, PACK};
+//! The policy used during a deletion (PACK and BACKWARD_SHIFT need linear probing, and mark under double hashing)
+enum OAHTDeletionPolicy {MARK, PACK, BACKWARD_SHIFT};
+
+//! How collisions are resolved: the probe sequence alone (linear probing or double hashing),
+//! linear probing where an element displaces any element closer to its home slot, or
+//! 4-way buckets with two candidate buckets per key (at most 8 slots looked at by a find)
+enum OAHTCollisionPolicy {PROBE_SEQUENCE, ROBIN_HOOD, CUCKOO};
+
+//! Where slot states live: inside each slot, or in a dense control-byte array
+enum OAHTLayoutPolicy {SLOT_STATE, CONTROL_BYTES};
+
+//! How the table size is chosen when the table grows
+enum OAHTSizingPolicy {PRIME_SIZES, POWER_OF_TWO_SIZES};
+
+//! A group of control bytes that is scanned with one instruction (AVX2/SSE2, scalar otherwise)
+struct OAHTControlGroup
+{
+#if defined(__AVX2__)
+  static const unsigned WIDTH = 32; //!< Slots per group
+#else
+  static const unsigned WIDTH = 16; //!< Slots per group
+#endif
+
+  //! Bit i of the result is set when byte i of the group equals Value
+  static unsigned Match(const unsigned char *Group, unsigned char Value)
+  {
+#if defined(__AVX2__)
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Group));
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(static_cast<char>(Value)))));
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Group));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(Value)))));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < WIDTH; ++i)
+      if (Group[i] == Value)
+        mask |= 1u << i;
+    return mask;
+#endif
+  }
+
+  //! Bit i of the result is set when byte i of the group has its high bit set
+  static unsigned MatchHighBit(const unsigned char *Group)
+  {
+#if defined(__AVX2__)
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(Group))));
+#elif defined(__SSE2__) || defined(_M_X64)
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Group))));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < WIDTH; ++i)
+      if (Group[i] & 0x80)
+        mask |= 1u << i;
+    return mask;
+#endif
+  }
+
+  //! Index of the lowest set bit (Mask must not be 0)
+  static unsigned LowestBit(unsigned Mask)
+  {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctz(Mask));
+#else
+    unsigned bit = 0;
+    while (!(Mask & 1))
+    {
+      Mask >>= 1;
+      ++bit;
+    }
+    return bit;
+#endif
+  }
+
+  //! Mask with the lowest Count bits set
+  static unsigned LowBits(unsigned Count)
+  {
+    return Count >= 32 ? ~0u : (1u << Count) - 1;
+  }
+};
 
 //! OAHashTable statistical info
 struct OAHTStats
 {
   //! Default constructor
-  OAHTStats() : Count_(0), TableSize_(0), Probes_(0), Expansions_(0),
-                    PrimaryHashFunc_(0), SecondaryHashFunc_(0) {};
+  OAHTStats() : Count_(0), TableSize_(0), Probes_(0), Expansions_(0), Shrinks_(0), Tombstones_(0),
+                    PrimaryHashFunc_(0), SecondaryHashFunc_(0), FullHashFunc_(0) {};
   unsigned Count_;             //!< Number of elements in the table
   unsigned TableSize_;         //!< Size of the table (total slots)
   unsigned Probes_;            //!< Number of probes performed
   unsigned Expansions_;        //!< Number of times the table grew
-  HASHFUNC PrimaryHashFunc_;   //!< Pointer to primary hash function
-  HASHFUNC SecondaryHashFunc_; //!< Pointer to secondary hash function
+  unsigned Shrinks_;           //!< Number of times the table shrank
+  unsigned Tombstones_;        //!< Slots marked DELETED (MARK policy)
+  HASHFUNC PrimaryHashFunc_;   //!< Pointer to primary hash function (0 unless keys are strings)
+  HASHFUNC SecondaryHashFunc_; //!< Pointer to secondary hash function (0 unless keys are strings)
+  FULLHASHFUNC FullHashFunc_;  //!< Pointer to full-width hash function (0 unless keys are strings)
+};
+
+//! Probe and cluster analytics of a table (histograms are indexed by length)
+struct OAHTAnalytics
+{
+  //! Default constructor
+  OAHTAnalytics() : LongestProbe_(0), LongestCluster_(0), Tombstones_(0), AverageSuccessful_(0), AverageUnsuccessful_(0) {}
+  std::vector<unsigned> SuccessfulProbes_;   //!< [n] = items that take n probes to find
+  std::vector<unsigned> UnsuccessfulProbes_; //!< [n] = home slots where a miss takes n probes (linear probing only)
+  std::vector<unsigned> ClusterSizes_;       //!< [n] = runs of n non-empty slots
+  unsigned LongestProbe_;                    //!< Most probes any item takes to find
+  unsigned LongestCluster_;                  //!< Longest run of non-empty slots
+  unsigned Tombstones_;                      //!< Slots marked DELETED (MARK policy)
+  double AverageSuccessful_;                 //!< Mean probes of a hit
+  double AverageUnsuccessful_;               //!< Mean probes of a miss (linear probing only)
+};
+
+/*!
+Probe accounting policies (the ProbeCounter parameter of OAHashTable).
+The table adds up the probes of an operation locally and calls Add()
+once per operation. Total() is only called by GetStats().
+*/
+
+//! One plain counter (the default). Not safe for concurrent const lookups.
+struct OAHTProbeCounter
+{
+  OAHTProbeCounter() : mProbes(0) {}
+
+  void Add(unsigned Probes) { mProbes += Probes; }
+  unsigned Total() const { return mProbes; }
+
+  unsigned mProbes; //!< Probes so far
+};
+
+//! No probe accounting at all (Probes_ is always 0)
+struct OAHTNoProbeCounter
+{
+  void Add(unsigned) {}
+  unsigned Total() const { return 0; }
+};
+
+/*!
+A counter per thread, combined by Total(). Threads get their own cache
+line, so lookups from many threads never write a shared line. Updates are
+plain (non-atomic) read-modify-writes; past STRIPES threads, threads share
+stripes and the count may lose probes.
+*/
+class OAHTThreadProbeCounter
+{
+  public:
+    static const unsigned STRIPES = 64; //!< Counters per table (a power of two)
+
+    OAHTThreadProbeCounter()
+    {
+      for (unsigned i = 0; i < STRIPES; ++i)
+        mStripes[i].Probes.store(0, std::memory_order_relaxed);
+    }
+
+    void Add(unsigned Probes)
+    {
+      std::atomic<unsigned>& probes = mStripes[ThreadIndex() & (STRIPES - 1)].Probes;
+      probes.store(probes.load(std::memory_order_relaxed) + Probes, std::memory_order_relaxed);
+    }
+
+    unsigned Total() const
+    {
+      unsigned total = 0;
+      for (unsigned i = 0; i < STRIPES; ++i)
+        total += mStripes[i].Probes.load(std::memory_order_relaxed);
+      return total;
+    }
+
+  private:
+      //! One thread's counter on its own cache line
+    struct Stripe
+    {
+      std::atomic<unsigned> Probes;                     //!< Probes by the threads using this stripe
+      char Padding[64 - sizeof(std::atomic<unsigned>)]; //!< Rest of the cache line
+    };
+
+      //! Numbers the threads in the order they first count a probe
+    static unsigned ThreadIndex()
+    {
+      static std::atomic<unsigned> next(0);
+      static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed);
+      return index;
+    }
+
+    Stripe mStripes[STRIPES]; //!< The per-thread counters
+};
+
+//! The time stamp counter (nanoseconds of a steady clock where there isn't one)
+inline unsigned long long OAHTCycles()
+{
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+//! Operations a tracer samples
+enum OAHTTraceOp {TRACE_INSERT, TRACE_FIND, TRACE_REMOVE};
+
+//! One sampled operation
+struct OAHTTraceRecord
+{
+  OAHTTraceOp Op;            //!< What the operation was
+  bool Resized;              //!< The table grew or shrank (or started an incremental resize) during it
+  unsigned Probes;           //!< Probes it took, re-insertions of a resize included
+  unsigned Moved;            //!< Elements it moved: the rest of the cluster for a PACK or backward
+                             //!< shift remove, displaced elements for Robin Hood and cuckoo inserts
+  unsigned long long Cycles; //!< Time it took, in OAHTCycles()
+};
+
+/*!
+A probe counter that also traces 1 in SampleEvery operations of each
+thread into a lock-free ring of Capacity records (a power of two), for
+one consumer at a time to Drain(). Writers never wait: when the consumer
+falls behind, the oldest records are overwritten and counted by
+Dropped(). Probes are counted by Counter, which has to be
+OAHTThreadProbeCounter if several threads find() at once. The table
+finds its hooks through OAHTTraceHooks, which compiles them to nothing
+for probe counters that don't trace.
+*/
+template <unsigned SampleEvery = 64, unsigned Capacity = 4096, typename Counter = OAHTProbeCounter>
+class OAHTSampledTracer : public Counter
+{
+  public:
+    typedef OAHTTraceRecord TraceRecord; //!< Marks the counter as a tracer
+
+    OAHTSampledTracer() : mHead(0), mTail(0), mDropped(0)
+    {
+      for (unsigned i = 0; i < Capacity; ++i)
+        mRing[i].Sequence.store(0, std::memory_order_relaxed);
+    }
+
+    void Add(unsigned Probes)
+    {
+      Counter::Add(Probes);
+      Current().Probes += Probes;
+    }
+
+      // Starts an operation, ended by End(). One begun inside another (the
+      // find and insert of an insert_or_assign) is part of the outer one, so
+      // only the outermost operations count toward the sample.
+    void Begin()
+    {
+      ThreadTrace& trace = Current();
+      if (trace.Depth++ != 0 || --trace.Countdown != 0)
+        return;
+
+      trace.Countdown = SampleEvery;
+      trace.Sampled = true;
+      trace.Probes = 0;
+      trace.Moved = 0;
+      trace.Start = OAHTCycles();
+    }
+
+    void Moved(unsigned Count) { Current().Moved += Count; }
+
+      // Ends an operation, recording it in the ring if it's the outermost and sampled
+    void End(OAHTTraceOp Op, bool Resized)
+    {
+      ThreadTrace& trace = Current();
+      if (--trace.Depth != 0 || !trace.Sampled)
+        return;
+
+      unsigned long long cycles = OAHTCycles() - trace.Start;
+      trace.Sampled = false;
+
+      // Odd while the record is written, so a consumer can tell a torn record
+      unsigned long long position = mHead.fetch_add(1, std::memory_order_relaxed);
+      Entry& entry = mRing[position & (Capacity - 1)];
+      entry.Sequence.store(2 * position + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      entry.Cycles.store(cycles, std::memory_order_relaxed);
+      entry.Counts.store(trace.Probes | static_cast<unsigned long long>(trace.Moved) << 32, std::memory_order_relaxed);
+      entry.Kind.store(static_cast<unsigned>(Op) | (Resized ? 0x100u : 0u), std::memory_order_relaxed);
+      entry.Sequence.store(2 * position + 2, std::memory_order_release);
+    }
+
+      // Copies out up to Count of the oldest records, returning how many it copied (records
+      // still being written are left for the next call)
+    std::size_t Drain(OAHTTraceRecord* Records, std::size_t Count)
+    {
+      unsigned long long head = mHead.load(std::memory_order_acquire);
+      std::size_t drained = 0;
+
+      // Records a whole ring behind were overwritten
+      if (head - mTail > Capacity)
+      {
+        mDropped += head - Capacity - mTail;
+        mTail = head - Capacity;
+      }
+
+      for (; drained < Count && mTail < head; ++mTail)
+      {
+        Entry& entry = mRing[mTail & (Capacity - 1)];
+        unsigned long long expected = 2 * mTail + 2;
+
+        unsigned long long sequence = entry.Sequence.load(std::memory_order_acquire);
+        if (sequence < expected)
+          break;
+
+        unsigned long long cycles = entry.Cycles.load(std::memory_order_relaxed);
+        unsigned long long counts = entry.Counts.load(std::memory_order_relaxed);
+        unsigned kind = entry.Kind.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Overwritten by a writer a lap ahead
+        if (sequence != expected || entry.Sequence.load(std::memory_order_relaxed) != expected)
+        {
+          ++mDropped;
+          continue;
+        }
+
+        OAHTTraceRecord& record = Records[drained++];
+        record.Op = static_cast<OAHTTraceOp>(kind & 0xff);
+        record.Resized = (kind & 0x100) != 0;
+        record.Probes = static_cast<unsigned>(counts);
+        record.Moved = static_cast<unsigned>(counts >> 32);
+        record.Cycles = cycles;
+      }
+
+      return drained;
+    }
+
+      // Records overwritten before they were drained
+    unsigned long long Dropped() const { return mDropped; }
+
+  private:
+    OAHTSampledTracer(const OAHTSampledTracer&);
+    OAHTSampledTracer& operator=(const OAHTSampledTracer&);
+
+      //! A record, written with relaxed atomics under its sequence number
+    struct Entry
+    {
+      std::atomic<unsigned long long> Sequence; //!< 2 * position + 2 once written (odd while writing)
+      std::atomic<unsigned long long> Cycles;   //!< OAHTTraceRecord::Cycles
+      std::atomic<unsigned long long> Counts;   //!< Probes, then Moved in the high half
+      std::atomic<unsigned> Kind;               //!< Op, then Resized in bit 8
+    };
+
+      //! The operation a thread is tracing
+    struct ThreadTrace
+    {
+      unsigned Depth;           //!< Operations running (the outermost and those inside it)
+      bool Sampled;             //!< The outermost operation is sampled
+      unsigned Countdown;       //!< Operations until the next sample
+      unsigned Probes;          //!< Probes of the sampled operation
+      unsigned Moved;           //!< Elements it moved
+      unsigned long long Start; //!< OAHTCycles() when it started
+    };
+
+    static ThreadTrace& Current()
+    {
+      static thread_local ThreadTrace trace = {0, false, SampleEvery, 0, 0, 0};
+      return trace;
+    }
+
+    Entry mRing[Capacity];                   //!< The records
+    std::atomic<unsigned long long> mHead;   //!< Positions handed to writers
+    char mPadding[64];                       //!< Keep writers off the consumer's line
+    unsigned long long mTail;                //!< Next position to drain
+    unsigned long long mDropped;             //!< Records lost to overwriting
+};
+
+template <typename> struct OAHTVoid { typedef void Type; };
+
+/*!
+The table's hooks into its probe counter: a Scope around each insert,
+find and remove, and Moved() where elements are moved. They do nothing
+unless the probe counter is a tracer (defines TraceRecord, see
+OAHTSampledTracer).
+*/
+template <typename Counter, typename Enable = void>
+struct OAHTTraceHooks
+{
+  struct Scope
+  {
+    Scope(Counter&, OAHTTraceOp, const unsigned&) {}
+  };
+
+  static void Moved(Counter&, unsigned) {}
+};
+
+//! The hooks of a tracer
+template <typename Counter>
+struct OAHTTraceHooks<Counter, typename OAHTVoid<typename Counter::TraceRecord>::Type>
+{
+    //! Traces the operation it's in scope for, if it's sampled and not inside another (TableSize
+    //! is watched for resizes)
+  class Scope
+  {
+    public:
+      Scope(Counter& Tracer, OAHTTraceOp Op, const unsigned& TableSize) :
+        mTracer(Tracer), mOp(Op), mTableSize(TableSize), mStartSize(TableSize)
+      {
+        Tracer.Begin();
+      }
+
+      ~Scope() { mTracer.End(mOp, mTableSize != mStartSize); }
+
+    private:
+      Scope(const Scope&);
+      Scope& operator=(const Scope&);
+
+      Counter& mTracer;
+      OAHTTraceOp mOp;
+      const unsigned& mTableSize;
+      unsigned mStartSize;
+  };
+
+  static void Moved(Counter& Tracer, unsigned Count) { Tracer.Moved(Count); }
+};
+
+/*!
+Key policies (the KeyStorage parameter of OAHashTable). KeyType is the key
+the client passes in, HashFunc and FullHashFunc are the types of the hash
+functions of the config, Equal() compares a stored key with a key and
+Fingerprint() is the table's own hash of a key. FullHash() is the
+FullHashFunc a config uses when it isn't given a hash function. Stored is the type of
+OAHTSlot::Key and converts to KeyType. The table copies keys in with Set()
+and rebuilds the storage (Swap() with a new one, Set() every live key,
+then Rebuilt()) when it rehashes or Wasteful() says so. SELF_CONTAINED is
+true when a Stored key doesn't point anywhere, so slots can be saved to a
+file and mapped back (snapshots).
+*/
+
+//! What the string key policies have in common
+struct OAHTStringKeys
+{
+  typedef const char *KeyType;       //!< Keys are strings
+  typedef HASHFUNC HashFunc;         //!< Same hash functions as always
+  typedef FULLHASHFUNC FullHashFunc; //!< Same hash functions as always
+
+  static bool Equal(const char *StoredKey, const char *Key) { return strcmp(StoredKey, Key) == 0; }
+  static unsigned Fingerprint(const char *Key) { return KeyFingerprint(Key); }
+  static unsigned long long FullHash(const char *Key) { return HashKey(Key); }
+};
+
+//! Keys copied into each slot (the default). Keys must be shorter than MAX_KEYLEN.
+struct OAHTInlineKeys : OAHTStringKeys
+{
+  typedef char Stored[MAX_KEYLEN]; //!< The key itself
+  static const bool SELF_CONTAINED = true;
+
+  void Set(Stored& Key, const char *Value) { if (Key != Value) strcpy(Key, Value); }
+  bool Wasteful() const { return false; }
+  void Rebuilt() {}
+  void Swap(OAHTInlineKeys&) {}
+};
+
+/*!
+Short keys inline (small-string style), longer keys copied into a
+bump-pointer arena owned by the table. Keys of any length are safe. A key
+replaced or removed leaves its arena copy behind until the arena is
+rebuilt, which happens when the table rehashes or once the arena has
+doubled since it was last rebuilt.
+*/
+class OAHTArenaKeys : public OAHTStringKeys
+{
+  public:
+    static const unsigned INLINE_KEYLEN = 16;  //!< Bytes of a stored key (keys shorter than this are inline)
+    static const unsigned BLOCK_SIZE = 4096;    //!< Smallest arena block
+    static const bool SELF_CONTAINED = false;   //!< Long keys point into the arena
+
+      //! A key, or (when the last byte is set) a pointer to its copy in the arena
+    struct Stored
+    {
+      char Bytes[INLINE_KEYLEN]; //!< The key, or the pointer
+
+      operator const char *() const;
+    };
+
+    OAHTArenaKeys() : mBlocks(0), mUsed(0), mLive(0) {}
+    ~OAHTArenaKeys();
+
+    void Set(Stored& Key, const char *Value);
+    bool Wasteful() const { return mUsed > 2 * mLive + BLOCK_SIZE; }
+    void Rebuilt() { mLive = mUsed; }
+    void Swap(OAHTArenaKeys& Other);
+
+  private:
+    OAHTArenaKeys(const OAHTArenaKeys&);
+    OAHTArenaKeys& operator=(const OAHTArenaKeys&);
+
+      //! A chunk of the arena (blocks never move, so copies stay valid)
+    struct Block
+    {
+      Block* Next;     //!< The previously filled block
+      unsigned Size;   //!< Bytes of Data
+      unsigned Used;   //!< Bytes of Data handed out
+      char* Data;      //!< The bytes
+    };
+
+    char* Allocate(unsigned bytes);
+
+    Block* mBlocks;    //!< The block being filled, then the older ones
+    unsigned mUsed;    //!< Bytes handed out
+    unsigned mLive;    //!< Bytes handed out when the arena was last rebuilt
+};
+
+/*!
+Integer keys (any integral K), stored and compared as they are, so
+integer IDs don't go through strings. Hash() and FullHash() are ready
+made hash functions for the config, but any of the HashFunc type work.
+*/
+template <typename K>
+struct OAHTIntegerKeys
+{
+  typedef K KeyType;                              //!< The key
+  typedef K Stored;                               //!< Stored as it is
+  static const bool SELF_CONTAINED = true;
+  typedef unsigned (*HashFunc)(K, unsigned);      //!< Hash function taking the key and table size
+  typedef unsigned long long (*FullHashFunc)(K);  //!< Full-width hash function taking the key
+
+  void Set(Stored& Key, K Value) { Key = Value; }
+  bool Wasteful() const { return false; }
+  void Rebuilt() {}
+  void Swap(OAHTIntegerKeys&) {}
+
+  static bool Equal(K StoredKey, K Key) { return StoredKey == Key; }
+  static unsigned Fingerprint(K Key) { return static_cast<unsigned>(FullHash(Key) >> 32); }
+
+    // A 64-bit mix of the key (the finalizer of MurmurHash3)
+  static unsigned long long FullHash(K Key)
+  {
+    unsigned long long hash = static_cast<unsigned long long>(Key);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+  static unsigned Hash(K Key, unsigned TableSize) { return static_cast<unsigned>(FullHash(Key) % TableSize); }
+};
+
+/*!
+Slot storage policies (the Allocator parameter of OAHashTable). The table
+gets its slots and control bytes from Allocate(Bytes), which throws
+std::bad_alloc when out of memory, and gives them back with Free(Memory,
+Bytes), with the same Bytes.
+*/
+
+//! The heap, through operator new (the default)
+struct OAHTHeapAllocator
+{
+  static void* Allocate(size_t Bytes) { return ::operator new(Bytes); }
+  static void Free(void* Memory, size_t) { ::operator delete(Memory); }
+};
+
+//! The heap, aligned to a cache line so no slot straddles two lines needlessly
+struct OAHTAlignedAllocator
+{
+  static const size_t ALIGNMENT = 64; //!< Bytes in a cache line
+
+  static void* Allocate(size_t Bytes)
+  {
+    void* memory = AllocateAligned(Bytes, ALIGNMENT);
+    if (!memory)
+      throw std::bad_alloc();
+    return memory;
+  }
+
+  static void Free(void* Memory, size_t) { FreeAligned(Memory); }
+};
+
+/*!
+Pages mapped from the system, so a big table takes few TLB entries.
+HugePageSize 0 uses transparent hugepages, 2MB or 1GB uses explicit
+hugepages when the system has them reserved (transparent ones
+otherwise). NumaNode binds the pages to a node (-1 for any). Tables
+smaller than a hugepage come from the heap, aligned to a cache line.
+*/
+template <size_t HugePageSize = 0, int NumaNode = -1>
+struct OAHTHugePageAllocator
+{
+  static void* Allocate(size_t Bytes)
+  {
+    void* memory = AllocatePages(Bytes, HugePageSize, NumaNode);
+    if (!memory)
+      throw std::bad_alloc();
+    return memory;
+  }
+
+  static void Free(void* Memory, size_t Bytes) { FreePages(Memory, Bytes, HugePageSize); }
+};
+
+/*!
+A snapshot written by a thread of its own while the table keeps taking
+changes. The table's memory is split into chunks of slots (with their
+occupancy words and control bytes). The thread copies one chunk at a time
+and writes it where it goes in the file. A change to a chunk that hasn't
+been copied yet copies it first, into one of QUEUE buffers the thread
+writes out (waiting for one to be free). So the file holds the table as it
+was when the snapshot began, in at most QUEUE + 1 chunks of memory. It's
+written under TempPath and renamed to Path once it's complete.
+*/
+class OAHTSnapshotWriter
+{
+  public:
+    enum { QUEUE = 4 };       //!< Buffers for chunks copied by changes
+    enum { MAX_REGIONS = 4 }; //!< Most regions of a chunk
+
+      //! Memory written a chunk at a time: chunk k is the Unit bytes at k * Unit (fewer in the last)
+    struct Region
+    {
+      const char* Memory;        //!< Where it is in the table
+      unsigned long long Offset; //!< Where it goes in the file
+      size_t Unit;               //!< Bytes per chunk
+      size_t Bytes;              //!< Bytes in all
+    };
+
+      // Takes the file (the header is already in it) and starts the thread.
+      // Throws std::bad_alloc or std::system_error (and leaves the file to
+      // the caller) if it can't.
+    OAHTSnapshotWriter(FILE* File, const char* Path, const char* TempPath, unsigned ChunkSlots,
+                       unsigned Chunks, const Region* Regions, unsigned RegionCount);
+    ~OAHTSnapshotWriter(); // Waits for the thread
+
+      // Makes sure the chunks of slots First through Last (past the end, and
+      // around, when First > Last) are copied before they change
+    void CopySlots(unsigned First, unsigned Last);
+    void CopyAll() { CopyChunks(0, mChunks - 1); }
+    bool AllCopied() const { return mCopied.load(std::memory_order_acquire) == mChunks; }
+
+      // Whether the file is complete (or given up on), and waiting for it.
+      // Wait returns false if it couldn't be written.
+    bool Done() const { return mFinished.load(std::memory_order_acquire); }
+    bool Wait();
+
+  private:
+    OAHTSnapshotWriter(const OAHTSnapshotWriter&);
+    OAHTSnapshotWriter& operator=(const OAHTSnapshotWriter&);
+
+    enum { UNCOPIED, COPYING, COPIED }; //!< Where a chunk is
+    enum { FREE = ~0u, FILLING = ~0u - 1 }; //!< A buffer without a chunk, and one a change is copying into
+
+    void Run();
+    void CopyChunks(unsigned first, unsigned last);
+    bool Claim(unsigned chunk);
+    void Copy(unsigned chunk, char* bytes) const;
+    void Copied(unsigned chunk);
+    void Write(unsigned chunk, const char* bytes);
+    bool WriteCopy(bool wait);
+    size_t RegionBytes(const Region& region, unsigned chunk) const;
+
+    FILE* mFile;                  //!< The file being written
+    std::string mPath;            //!< Its name once it's complete
+    std::string mTempPath;        //!< Its name until then
+    unsigned mChunkSlots;         //!< Slots per chunk
+    unsigned mChunks;             //!< Chunks in the table
+    Region mRegions[MAX_REGIONS]; //!< The memory of a chunk
+    unsigned mRegionCount;        //!< Regions in use
+    size_t mChunkBytes;           //!< Bytes of a chunk's copy
+
+    std::vector<std::atomic<unsigned char> > mStates; //!< UNCOPIED, COPYING or COPIED, per chunk
+    std::atomic<unsigned> mCopied;           //!< Chunks COPIED
+    std::vector<char> mBuffer;               //!< The thread's copy of a chunk
+    std::vector<std::vector<char> > mCopies; //!< The QUEUE buffers for changes
+    std::vector<unsigned> mCopyOf;           //!< The chunk in each buffer, FREE or FILLING
+    std::mutex mMutex;                       //!< Guards mCopyOf
+    std::condition_variable mChanged;        //!< Signalled when mCopyOf changes
+    unsigned mWritten;                       //!< Chunks written (by the thread)
+    bool mFailed;                            //!< A write failed (by the thread)
+    bool mSucceeded;                         //!< The file is complete (set before mFinished)
+    std::atomic<bool> mFinished;             //!< The thread is done
+    std::thread mThread;                     //!< Writes the file
+};
+
+//! The probe sequence of a table with a fixed policy
+enum OAHTProbing {LINEAR_PROBING, DOUBLE_HASHING};
+
+/*!
+Policies fixed at compile time (the Policies parameter of OAHashTable). The
+default takes the probing, deletion and hash functions from the config
+at runtime. OAHTFixedPolicy fixes them in the type instead, so the hot
+paths have no branches on them and the hash is inlined: Probing and
+Deletion replace the config's hash functions, DoubleHashing_,
+DeletionPolicy_ and CollisionPolicy_ (always PROBE_SEQUENCE), and Hash is
+a default-constructible functor returning a full-width hash of a key
+(unsigned long long operator()(KeyType) const), used like FullHashFunc_.
+CacheHashes replaces CacheHashes_. The config's other settings still apply.
+
+A policy also picks what each slot keeps besides its key, data and state
+(see OAHTSlotExtras). The default keeps both extras. A fixed policy keeps
+the probes only for BACKWARD_SHIFT under linear probing, the one fixed
+path that moves elements by their distance (GetAnalytics walks each key's
+probe sequence instead), and keeps the hash only with CacheHashes.
+*/
+
+//! The probes it takes to find a slot's key (see OAHTSlotExtras)
+template <bool Kept>
+struct OAHTSlotProbes
+{
+  int GetProbes() const { return probes; }
+  void SetProbes(int Probes) { probes = Probes; }
+
+  int probes; //!< Probes it takes to find the key
+};
+
+//! No probes (GetProbes is 0)
+template <>
+struct OAHTSlotProbes<false>
+{
+  int GetProbes() const { return 0; }
+  void SetProbes(int) {}
+};
+
+//! The fingerprint of a slot's key (see OAHTSlotExtras)
+template <bool Kept>
+struct OAHTSlotHash
+{
+  unsigned GetHash() const { return Hash; }
+  void SetHash(unsigned Fingerprint) { Hash = Fingerprint; }
+
+  unsigned Hash; //!< Fingerprint of the key (kept when CacheHashes_ is set)
+};
+
+//! No fingerprint (GetHash is 0)
+template <>
+struct OAHTSlotHash<false>
+{
+  unsigned GetHash() const { return 0; }
+  void SetHash(unsigned) {}
+};
+
+//! What a slot keeps besides its key, data and state (an empty base when neither is kept)
+template <bool Probes, bool Hashes>
+struct OAHTSlotExtras : OAHTSlotProbes<Probes>, OAHTSlotHash<Hashes>
+{
+};
+
+//! Everything from the config (the default)
+struct OAHTRuntimePolicy
+{
+  static const bool FIXED = false;
+
+  static const OAHTProbing PROBING = LINEAR_PROBING; //!< Unused
+  static const OAHTDeletionPolicy DELETION = MARK;   //!< Unused
+  static const bool CACHE_HASHES = false;            //!< Unused
+
+  static const bool SLOT_PROBES = true; //!< Slots keep their probes
+  static const bool SLOT_HASHES = true; //!< Slots keep their hashes
+
+  //! Unused
+  struct Hash
+  {
+    template <typename K>
+    unsigned long long operator()(K) const { return 0; }
+  };
+};
+
+//! Probing, deletion, the hash function and hash caching fixed in the type
+template <OAHTProbing Probing, OAHTDeletionPolicy Deletion, typename HashFunctor, bool CacheHashes = false>
+struct OAHTFixedPolicy
+{
+  static const bool FIXED = true;
+
+  static const OAHTProbing PROBING = Probing;
+  static const OAHTDeletionPolicy DELETION = Deletion;
+  static const bool CACHE_HASHES = CacheHashes;
+
+  //! Backward shifts move elements by their distance (double hashing marks instead)
+  static const bool SLOT_PROBES = Deletion == BACKWARD_SHIFT && Probing == LINEAR_PROBING;
+  static const bool SLOT_HASHES = CacheHashes; //!< Only kept to be cached
+
+  typedef HashFunctor Hash;
 };
 
 //! Hash table definition (open-addressing)
-template <typename T>
+template <typename T, typename ProbeCounter = OAHTProbeCounter, typename KeyStorage = OAHTInlineKeys, typename Allocator = OAHTHeapAllocator,
+          typename Policies = OAHTRuntimePolicy>
 class OAHashTable
 {
   public:
 
     typedef void (*FREEPROC)(T); //!< client-provided free proc (we own the data)
+    typedef typename KeyStorage::KeyType KeyType;           //!< The key (const char * by default)
+    typedef typename KeyStorage::HashFunc HashFunc;         //!< HASHFUNC for string keys
+    typedef typename KeyStorage::FullHashFunc FullHashFunc; //!< FULLHASHFUNC for string keys
 
     //! Configuration for the hash table
     struct OAHTConfig
     {
-      //! Non-default constructor
+      //! Non-default constructor. Without a PrimaryHashFunc, FullHashFunc_ is the key
+      //! policy's FullHash (and any SecondaryHashFunc just turns on DoubleHashing_).
       OAHTConfig(unsigned InitialTableSize, 
-                 HASHFUNC PrimaryHashFunc, 
-                 HASHFUNC SecondaryHashFunc = 0,
+                 HashFunc PrimaryHashFunc = 0, 
+                 HashFunc SecondaryHashFunc = 0,
                  double MaxLoadFactor = 0.5,
                  double GrowthFactor = 2.0, 
                  OAHTDeletionPolicy Policy = PACK,
                  FREEPROC FreeProc = 0) :
 
         InitialTableSize_(InitialTableSize), PrimaryHashFunc_(PrimaryHashFunc), 
-        SecondaryHashFunc_(SecondaryHashFunc), MaxLoadFactor_(MaxLoadFactor), 
+        SecondaryHashFunc_(PrimaryHashFunc ? SecondaryHashFunc : 0), MaxLoadFactor_(MaxLoadFactor), 
         GrowthFactor_(GrowthFactor), DeletionPolicy_(Policy),
-        FreeProc_(FreeProc) {}
+        FreeProc_(FreeProc), FullHashFunc_(PrimaryHashFunc ? 0 : &KeyStorage::FullHash),
+        DoubleHashing_(!PrimaryHashFunc && SecondaryHashFunc),
+        LayoutPolicy_(SLOT_STATE), CacheHashes_(false), SizingPolicy_(PRIME_SIZES),
+        IncrementalResize_(false), ResizeStep_(64), MaxTombstoneFactor_(0),
+        CollisionPolicy_(PROBE_SEQUENCE), RehashThreads_(1), MinLoadFactor_(0) {}
+
+      //! Non-default constructor (one full-width hash function for both the index and the stride)
+      OAHTConfig(unsigned InitialTableSize, 
+                 FullHashFunc FullHashFunc, 
+                 bool DoubleHashing = false,
+                 double MaxLoadFactor = 0.5,
+                 double GrowthFactor = 2.0, 
+                 OAHTDeletionPolicy Policy = PACK,
+                 FREEPROC FreeProc = 0) :
+
+        InitialTableSize_(InitialTableSize), PrimaryHashFunc_(0), 
+        SecondaryHashFunc_(0), MaxLoadFactor_(MaxLoadFactor), 
+        GrowthFactor_(GrowthFactor), DeletionPolicy_(Policy),
+        FreeProc_(FreeProc), FullHashFunc_(FullHashFunc), DoubleHashing_(DoubleHashing),
+        LayoutPolicy_(SLOT_STATE), CacheHashes_(false), SizingPolicy_(PRIME_SIZES),
+        IncrementalResize_(false), ResizeStep_(64), MaxTombstoneFactor_(0),
+        CollisionPolicy_(PROBE_SEQUENCE), RehashThreads_(1), MinLoadFactor_(0) {}
 
       unsigned InitialTableSize_;         //!< The starting table size
-      HASHFUNC PrimaryHashFunc_;          //!< First hash function
-      HASHFUNC SecondaryHashFunc_;        //!< Hash function to resolve collisions
+      HashFunc PrimaryHashFunc_;          //!< First hash function
+      HashFunc SecondaryHashFunc_;        //!< Hash function to resolve collisions
       double MaxLoadFactor_;              //!< Maximum LF before growing
       double GrowthFactor_;               //!< The amount to grow the table
-      OAHTDeletionPolicy DeletionPolicy_; //!< MARK or PACK
+      OAHTDeletionPolicy DeletionPolicy_; //!< MARK, PACK or BACKWARD_SHIFT
       FREEPROC FreeProc_;                 //!< Client-provided free function
+      FullHashFunc FullHashFunc_;         //!< Replaces both HASHFUNCs when set
+      bool DoubleHashing_;                //!< Derive a stride from FullHashFunc_
+
+        // Optional settings (assign after construction)
+      OAHTLayoutPolicy LayoutPolicy_;       //!< SLOT_STATE or CONTROL_BYTES
+      bool CacheHashes_;                    //!< Store each key's hash in its slot
+      OAHTSizingPolicy SizingPolicy_;       //!< PRIME_SIZES or POWER_OF_TWO_SIZES
+      bool IncrementalResize_;              //!< Move elements to a grown table a few at a time
+      unsigned ResizeStep_;                 //!< Old slots moved per insert/remove while resizing
+      double MaxTombstoneFactor_;           //!< Rehash in place past this fraction of DELETED slots (0 never)
+      OAHTCollisionPolicy CollisionPolicy_; //!< PROBE_SEQUENCE, ROBIN_HOOD or CUCKOO (both ignore LayoutPolicy_)
+      unsigned RehashThreads_;              //!< Threads a large rehash is spread over (0 for one per core)
+      double MinLoadFactor_;                //!< Shrink when a remove leaves the LF below this (0 never)
     };
       
-      //! Slots that will hold the key/data pairs
-    struct OAHTSlot
+      //! Slots that will hold the key/data pairs (and the extras of the policy)
+    struct OAHTSlot : OAHTSlotExtras<Policies::SLOT_PROBES, Policies::SLOT_HASHES>
     {
       //! The 3 possible states the slot can be in
       enum OAHTSlot_State {OCCUPIED, UNOCCUPIED, DELETED};
 
-      char Key[MAX_KEYLEN]; //!< Key is a string
-      T Data;               //!< Client data
-      OAHTSlot_State State; //!< The state of the slot
-      int probes;           //!< For testing
+      //! The extras of the policy (probes and hash)
+      typedef OAHTSlotExtras<Policies::SLOT_PROBES, Policies::SLOT_HASHES> Extras;
+
+      OAHTSlot() {}  //!< Leaves Data unconstructed
+      ~OAHTSlot() {} //!< The table destroys Data
+
+      typename KeyStorage::Stored Key; //!< The key (see KeyStorage)
+      union { T Data; };               //!< Client data (only constructed while OCCUPIED)
+      OAHTSlot_State State;            //!< The state of the slot
     };
 
     OAHashTable(const OAHTConfig& Config); // Constructor
     ~OAHashTable();                        // Destructor
 
+      // Serves the table saved by SaveSnapshot straight from the file,
+      // mapped copy-on-write (nothing is read until a lookup touches it).
+      // The config must have the hash functions and policies the table was
+      // saved with. Throws an exception (E_SNAPSHOT) if the file can't be
+      // mapped or doesn't match.
+    OAHashTable(const OAHTConfig& Config, const char *SnapshotPath);
+
+      // Writes the slots and control bytes to a file as they are, behind a
+      // header with the sizes, the policies, and a check of the hash
+      // functions (finishes an incremental resize first). T must be
+      // trivially copyable and the keys SELF_CONTAINED. Throws an exception
+      // (E_SNAPSHOT) if the file can't be written.
+    void SaveSnapshot(const char *Path);
+
+      // Writes a snapshot from a thread instead, of the table as it is now,
+      // while the table keeps taking changes (see OAHTSnapshotWriter: a
+      // change first copies the chunks it can touch that haven't been
+      // written, which is every chunk for double hashing, cuckoo, and
+      // anything that rehashes or clears). The file is named Path once it's
+      // complete. With a LogPath, logging restarts there at the same moment,
+      // so the snapshot and that log recover the table. Waits for an earlier
+      // background snapshot first, and throws an exception (E_SNAPSHOT) if
+      // the file can't be started.
+    void BeginBackgroundSnapshot(const char *Path, const char *LogPath = 0);
+
+      // Whether the background snapshot has been written (true if there is
+      // none). Throws an exception (E_SNAPSHOT) if it failed.
+    bool BackgroundSnapshotDone(bool Wait = false);
+
+      // An append-only log of every insert, assign, remove and clear, to
+      // replay onto a snapshot. Append continues an existing log of a table
+      // like this one. Records are buffered (LOG_BUFFER bytes) until a flush.
+      // Needs the same data and keys as snapshots. Throws an exception
+      // (E_SNAPSHOT) if the log can't be opened or written.
+    void OpenLog(const char *Path, bool Append = true);
+    void FlushLog();
+    void CloseLog();
+
+      // Applies a log to the table (without logging it again), ignoring a
+      // last record cut short by a crash. Returns the records applied.
+      // Throws an exception (E_SNAPSHOT) if the file isn't a log of a table
+      // like this one.
+    size_t ReplayLog(const char *Path);
+
       // Insert a key/data pair into table. Throws an exception if the
       // insertion is unsuccessful.
-    void insert(const char *Key, const T& Data);
+    void insert(KeyType Key, const T& Data);
+    void insert(KeyType Key, T&& Data);
+
+      // Insert a key and data constructed in its slot from Args. Throws an
+      // exception if the insertion is unsuccessful.
+    template <typename... Args>
+    void emplace(KeyType Key, Args&&... args);
+
+      // Same as insert/emplace, but return false instead of throwing
+      // E_DUPLICATE when the key is already in the table
+    bool try_insert(KeyType Key, const T& Data);
+    bool try_insert(KeyType Key, T&& Data);
+    template <typename... Args>
+    bool try_emplace(KeyType Key, Args&&... args);
+
+      // Insert, or replace the data of a key already in the table (the free
+      // proc gets the old data). Returns true if the key was inserted.
+    bool insert_or_assign(KeyType Key, const T& Data);
+    bool insert_or_assign(KeyType Key, T&& Data);
+
+      // Grows the table once so Count items fit without growing again
+      // (finishes an incremental resize first). Never shrinks the table.
+    void reserve(unsigned Count);
+
+      // Shrinks the table to the smallest size that holds its items under
+      // the max load factor (no smaller than InitialTableSize_), in one
+      // rehash. With a MinLoadFactor_, removes do the same on their own,
+      // sizing the table halfway between the two load factors so it takes
+      // many inserts or removes before it resizes again. MinLoadFactor_
+      // should be under MaxLoadFactor_ / GrowthFactor_, the load factor a
+      // growth leaves, or a remove right after growing shrinks the table.
+    void shrink_to_fit();
+
+      // Inserts Count key/data pairs (or the pairs of a forward iterator
+      // range, whose first converts to KeyType and second to T). The table
+      // is reserved for them up front, and each window of keys has its
+      // home slots prefetched before it is inserted. Keys already in the
+      // table are skipped. Returns the number of keys inserted.
+    size_t insert_bulk(const KeyType* Keys, const T* Data, size_t Count);
+    template <typename ForwardIt>
+    size_t insert_bulk(ForwardIt First, ForwardIt Last);
 
       // Delete an item by key. Throws an exception if the key doesn't exist.
       // Compacts the table by moving key/data pairs, if necessary
-    void remove(const char *Key);
+    void remove(KeyType Key);
 
       // Find and return data by key. Throws an exception (E_ITEM_NOT_FOUND)
       // if not found.
-    const T& find(const char *Key) const;
+    const T& find(KeyType Key) const;
+
+      // Lookups that don't throw: the data (0 if not found), whether the key
+      // is in the table, and a copy of the data (or Default if not found)
+    const T* try_find(KeyType Key) const;
+    bool contains(KeyType Key) const;
+    T find_or(KeyType Key, const T& Default) const;
+
+      // Finds Count keys, setting Data[i] to the data of Keys[i] (0 if not
+      // found). The keys are hashed and their home slots prefetched a
+      // window at a time before any of them is looked up, so the cache
+      // misses overlap. Returns the number of keys found.
+    size_t find_batch(const KeyType* Keys, size_t Count, const T** Data) const;
+
+#if __cplusplus >= 201703L
+      // Find by a string that isn't NUL-terminated (string keys only).
+      // Throws an exception (E_ITEM_NOT_FOUND) if not found.
+    const T& find(std::string_view Key) const;
+    const T* try_find(std::string_view Key) const;
+#endif
 
       // Removes all items from the table (Doesn't deallocate table)
     void clear();
 
       // Allow the client to peer into the data
     OAHTStats GetStats() const;
+
+      // The probe counter (to drain an OAHTSampledTracer)
+    ProbeCounter& GetProbeCounter() const;
     const OAHTSlot *GetTable() const;
 
+      // Probe-length histograms, clusters and tombstones. Walks the whole
+      // table, so it's meant for occasional reporting.
+    OAHTAnalytics GetAnalytics() const;
+
+      // Calls Visit(Key, Data) for every item in the table (including any
+      // not yet moved out of the old table by an incremental resize)
+    template <typename Visitor>
+    void for_each(Visitor Visit) const;
+
+      //! Walks the occupied slots in the same order as for_each, skipping
+      //! empty stretches a word of the occupancy bitmap (64 slots) at a
+      //! time. Any change to the table invalidates it.
+    class const_iterator
+    {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef OAHTSlot value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const OAHTSlot* pointer;
+        typedef const OAHTSlot& reference;
+
+        const_iterator() : mOwner(0), mTable(0), mIndex(0) {}
+
+        reference operator*() const { return mTable[mIndex]; }
+        pointer operator->() const { return &mTable[mIndex]; }
+
+          // The item's key and data
+        KeyType key() const { return static_cast<KeyType>(mTable[mIndex].Key); }
+        const T& data() const { return mTable[mIndex].Data; }
+
+        const_iterator& operator++() { mOwner->Advance(*this); return *this; }
+        const_iterator operator++(int) { const_iterator was = *this; mOwner->Advance(*this); return was; }
+
+        bool operator==(const const_iterator& rhs) const { return mTable == rhs.mTable && mIndex == rhs.mIndex; }
+        bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+
+      private:
+        friend class OAHashTable;
+
+        const OAHashTable* mOwner; //!< The table walked
+        const OAHTSlot* mTable;    //!< The old table or the table
+        unsigned mIndex;           //!< The slot (the table's size at the end)
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
   private: // Some suggestions (You don't have to use any of this.)
   
-    void InsertInTable(OAHTSlot* table, unsigned tableSize, const char *Key, const T& Data);
+      // The insertion done by try_emplace and insert_bulk once the table
+      // has room (logged if there is a log; PlaceNew does the work).
+      // Returns false if the key is already in the table.
+    template <typename... Args>
+    bool InsertNew(KeyType Key, unsigned fingerprint, Args&&... args);
+    template <typename... Args>
+    bool PlaceNew(KeyType Key, unsigned fingerprint, Args&&... args);
+
+    template <typename... Args>
+    bool InsertInTable(OAHTSlot* table, unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, Args&&... args);
+
+      // The data of a slot is only constructed while it's OCCUPIED. These
+      // construct it, move it to another slot (destroying the original,
+      // whose state the caller sets), swap it and free it.
+    template <typename... Args>
+    void FillSlot(OAHTSlot& slot, KeyType Key, unsigned fingerprint, Args&&... args);
+    static void MoveSlot(OAHTSlot& to, OAHTSlot& from);
+    static void SwapSlots(OAHTSlot& a, OAHTSlot& b);
+    void FreeData(OAHTSlot& slot) const;
 
       // Expands the table when the load factor reaches a certain point
       // (greater than MaxLoadFactor) Grows the table by GrowthFactor,
       // making sure the new size is prime by calling GetClosestPrime
+      // (or a power of two, depending on the sizing policy)
     void GrowTable();
 
+      // Rebuilds the table at the given size, dropping the tombstones
+    void Rehash(unsigned newTableSize);
+
+      // Rehashing a large table over RehashThreads_ threads. Each thread
+      // moves a range of the old slots, claiming new slots through claims.
+      // Only the probe sequence policy with keys stored in the slots and
+      // data that moves without throwing qualifies. Returns false (having
+      // done nothing) when it doesn't, or when the table is too small to
+      // be worth it.
+    bool RehashInParallel(OAHTSlot* newTable, unsigned char* newControl, unsigned newTableSize);
+    void RehashRange(OAHTSlot* newTable, unsigned char* newControl, unsigned newTableSize, std::atomic<unsigned char>* claims,
+                     unsigned begin, unsigned end, unsigned* probes);
+
+      // Rehashes in place when tombstones pass MaxTombstoneFactor_
+    void PurgeTombstones();
+
+      // The number of slots that holds Count items under a load factor
+    static unsigned SlotsToHold(unsigned Count, double LoadFactor);
+
+      // Shrinking: rehashes to the size holding the items at LoadFactor
+      // (returns false if that isn't smaller), and the check removes do
+      // against MinLoadFactor_
+    bool ShrinkTo(double LoadFactor);
+    void ShrinkIfSparse();
+
+    static unsigned SizeFor(const OAHTConfig& Config, unsigned requested);
+
+    unsigned GrownTableSize() const;
+
+      // Incremental resizing: the old table is kept next to the grown one
+      // until MigrateSlots has moved every element out of it. Moved and
+      // removed elements are left as DELETED so the old probe chains hold.
+    void BeginIncrementalGrow();
+    void MigrateSlots(unsigned count);
+    void ReleaseOldTable();
+
       // Workhorse method to locate an item (if it exists)
       // Returns the index of the item in the table
       // Sets Slot to point to the slot in the table where it belongs 
       // Returns -1 if it's not in the table
-    int IndexOf(const char *Key, OAHTSlot* &Slot) const;
+    int IndexOf(KeyType Key, OAHTSlot* &Slot) const;
+    int IndexOfIn(OAHTSlot* table, const unsigned char* control, unsigned tableSize, KeyType Key, OAHTSlot* &Slot) const;
+    int IndexOfFrom(OAHTSlot* table, const unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, unsigned stride, OAHTSlot* &Slot) const;
+
+      // Keys find_batch() hashes and prefetches before looking them up
+    enum { BATCH_WINDOW = 16 };
+
+      // The fewest old slots a rehash thread is given
+    enum { REHASH_SHARE = 64 * 1024 };
 
     void PrintTable(OAHTSlot* table, unsigned tableSize) const;
 
-    void CheckForMarkInsertionDuplicate(unsigned index, unsigned stride, OAHTSlot* table, unsigned tableSize, const char* Key);
+    bool CheckForMarkInsertionDuplicate(unsigned index, unsigned stride, OAHTSlot* table, unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned& probes);
+
+      // Key fingerprints, needed by the control bytes and the cached hashes.
+      // A slot's cached hash is compared before its key.
+    unsigned Fingerprint(KeyType Key) const;
+    void ProbeStart(KeyType Key, unsigned fingerprint, unsigned tableSize, unsigned& index, unsigned& stride) const;
+
+      // Value % Divisor, with multiplies when the divisor is one CacheModulo()
+      // prepared for the table size (prime sizes would divide on every probe start)
+    unsigned Remainder(unsigned Value, unsigned Divisor) const;
+    void CacheModulo(unsigned tableSize);
+
+      // Starts loading the slots (and control bytes) a probe of the current
+      // table begins at, both buckets under the cuckoo policy
+    void PrefetchProbeStart(KeyType Key, unsigned fingerprint, unsigned index) const;
+    bool DoubleHashing() const;
+
+      // The policies that fixed Policies turn into constants: whether the
+      // key has a full-width hash, that hash, and the deletion policy
+    bool HasFullHash() const;
+    unsigned long long FullHash(KeyType Key) const;
+    OAHTDeletionPolicy DeletionPolicy() const;
+    unsigned SlotFingerprint(const OAHTSlot& slot) const;
+    bool KeyMatches(const OAHTSlot& slot, unsigned fingerprint, KeyType Key) const;
+
+      // The probes it takes to find the key of an occupied slot (walked
+      // from its home slot when the policy's slots don't keep them)
+    unsigned ProbesOf(unsigned index) const;
+
+      // Control bytes (CONTROL_BYTES layout). An occupied slot stores 7 bits
+      // of the key's fingerprint remixed, so most mismatches are rejected
+      // without touching the slot itself. The first group of control bytes
+      // is mirrored past the end so a group can be loaded at any index.
+    enum { CTRL_EMPTY = 0x80, CTRL_DELETED = 0xFE };
+
+    unsigned char* AllocateControl(unsigned tableSize) const;
+    void FreeControl(unsigned char* control, unsigned tableSize) const;
+
+      // Slots from the Allocator, all UNOCCUPIED, and their release
+    static OAHTSlot* AllocateSlots(unsigned tableSize);
+    static void FreeSlots(OAHTSlot* table, unsigned tableSize);
+
+      // Every table is followed (in the same allocation) by a bitmap with a
+      // bit per slot, set while the slot is OCCUPIED. Whatever changes a
+      // slot's state keeps its bit in step, so walks of the items can skip
+      // 64 empty or DELETED slots at a time.
+    static std::size_t SlotBytes(unsigned tableSize);
+    static unsigned long long* Occupancy(OAHTSlot* table, unsigned tableSize);
+    static const unsigned long long* Occupancy(const OAHTSlot* table, unsigned tableSize);
+    static void SetOccupied(OAHTSlot* table, unsigned tableSize, unsigned index, bool occupied);
+    static unsigned NextOccupied(const OAHTSlot* table, unsigned tableSize, unsigned index);
+    static unsigned LowestBit(unsigned long long Word);
+
+      // Moves an iterator to the next item
+    void Advance(const_iterator& it) const;
+    static void SetControl(unsigned char* control, unsigned tableSize, unsigned index, unsigned char value);
+    static unsigned char Fragment(unsigned fingerprint);
+
+      // Group probing (linear probing over control bytes, a group at a time)
+    bool UseGroupProbing(const unsigned char* control, unsigned tableSize) const;
+    int IndexOfGroup(OAHTSlot* table, const unsigned char* control, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, OAHTSlot* &Slot) const;
+    int GroupInsertIndex(OAHTSlot* table, const unsigned char* control, unsigned tableSize, unsigned index, unsigned fingerprint, KeyType Key);
+
+      // Robin Hood hashing. Each slot's probes field is its distance from
+      // home + 1, and the distances never decrease along a cluster, so a
+      // lookup stops at the first slot closer to home than the key would be.
+    bool RobinHood() const;
+    template <typename... Args>
+    bool RobinHoodInsert(OAHTSlot* table, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, Args&&... args);
+    int RobinHoodIndexOf(OAHTSlot* table, unsigned tableSize, KeyType Key, unsigned fingerprint, unsigned index, OAHTSlot* &Slot) const;
+
+      // Closes the hole left by a removal by moving later elements back
+      // (BACKWARD_SHIFT), using the distances kept in the slots
+    void BackwardShift(unsigned hole);
+
+      // Rebuilds the key storage from the live keys, dropping the copies
+      // of keys that were removed or moved
+    void CompactKeys();
+    void StoreKeysAgain(OAHTSlot* table, unsigned tableSize);
+
+      // Cuckoo hashing. The table is split into buckets of CUCKOO_WAYS
+      // slots and a key lives in one of its two buckets. An insert into two
+      // full buckets displaces an element to its other bucket, and so on,
+      // growing the table when the chain passes CUCKOO_MAX_KICKS. Removals
+      // just empty the slot, whatever the deletion policy, and incremental
+      // resizing isn't used.
+    enum { CUCKOO_WAYS = 4, CUCKOO_MAX_KICKS = 128 };
+
+    bool Cuckoo() const;
+    void CuckooBuckets(KeyType Key, unsigned fingerprint, unsigned tableSize, unsigned& first, unsigned& second) const;
+    template <typename... Args>
+    bool CuckooInsert(KeyType Key, Args&&... args);
+    bool CuckooPlace(OAHTSlot* table, unsigned tableSize, OAHTSlot& carried);
+    void CuckooReturn(OAHTSlot* newTable, unsigned newTableSize, OAHTSlot& carried);
+    int CuckooEmptyWay(const OAHTSlot* table, unsigned bucket, unsigned& probes) const;
+    int CuckooIndexOf(OAHTSlot* table, unsigned tableSize, KeyType Key, unsigned fingerprint, OAHTSlot* &Slot) const;
     
+      //! The start of a snapshot file (the slots and their occupancy bitmap
+      //! start on a page of their own)
+    struct OAHTSnapshotHeader
+    {
+      char Magic[8];                   //!< SNAPSHOT_MAGIC
+      unsigned SlotSize;               //!< sizeof(OAHTSlot)
+      unsigned DataSize;               //!< sizeof(T)
+      unsigned TableSize;              //!< Slots in the table
+      unsigned Count;                  //!< Elements in the table
+      unsigned Tombstones;             //!< DELETED slots
+      unsigned Layout;                 //!< OAHTLayoutPolicy
+      unsigned Collision;              //!< OAHTCollisionPolicy
+      unsigned Sizing;                 //!< OAHTSizingPolicy
+      unsigned Deletion;               //!< OAHTDeletionPolicy
+      unsigned Flags;                  //!< SNAPSHOT_CACHE_HASHES, SNAPSHOT_DOUBLE_HASHING
+      unsigned HashIdentity;           //!< HashIdentity() of the table
+      unsigned long long SlotsOffset;  //!< Where the slots start
+      unsigned long long ControlBytes; //!< Bytes of control bytes after the slots (0 for none)
+      unsigned long long ControlOffset; //!< Where the control bytes start
+    };
+
+    enum { SNAPSHOT_ALIGNMENT = 4096, SNAPSHOT_SAMPLES = 16, SNAPSHOT_SCAN = 64 };
+    enum { SNAPSHOT_CACHE_HASHES = 1, SNAPSHOT_DOUBLE_HASHING = 2 };
+    static const char* SnapshotMagic() { return "OAHTSNP3"; }
+
+      // Sets up what both constructors share (the fixed policy and the stats)
+    void Configure();
+
+      // Frees a table with its control bytes, or unmaps the snapshot if it's
+      // the snapshot's table
+    void ReleaseTable(OAHTSlot* table, unsigned char* control, unsigned tableSize);
+
+      // Hash of where a few of the table's keys start probing, so a snapshot
+      // loaded with other hash functions is caught
+    unsigned HashIdentity() const;
+    unsigned SnapshotFlags() const;
+
+      // The header of a snapshot of the table as it is
+    OAHTSnapshotHeader SnapshotHeader() const;
+
+      // Has the background snapshot copy what a change of Key can touch
+      // before it changes (the cluster around the key's home slot), or
+      // the whole table
+    void GuardSnapshot(KeyType Key);
+    void GuardSnapshot();
+
+      //! The start of a log file, followed by records of an op, a key and data
+    struct OAHTLogHeader
+    {
+      char Magic[8];     //!< LogMagic()
+      unsigned KeySize;  //!< sizeof(KeyStorage::Stored)
+      unsigned DataSize; //!< sizeof(T)
+    };
+
+    enum OAHTLogOp {LOG_INSERT = 1, LOG_REMOVE, LOG_CLEAR};
+    enum { LOG_BUFFER = 64 * 1024, SNAPSHOT_CHUNK = 1024 * 1024 };
+    static const char* LogMagic() { return "OAHTLOG1"; }
+
+      // Appends a record (Data is 0 for removes and clears)
+    void LogOp(OAHTLogOp Op, KeyType Key, const void* Data);
+
+    typedef OAHTTraceHooks<ProbeCounter> TraceHooks; //!< No-ops unless ProbeCounter traces
+
     // Other private fields and methods...
     OAHTSlot* mTable;
+    unsigned char* mControl; //!< Control bytes, 0 unless using CONTROL_BYTES
+
+    OAHTSlot* mOldTable;        //!< Table being migrated from (incremental resizing), or 0
+    unsigned char* mOldControl; //!< Control bytes of the old table
+    unsigned mOldTableSize;     //!< Size of the old table
+    unsigned mMigrateIndex;     //!< Next old slot to migrate
+
+    FastModulo mIndexModulo;    //!< By the table size (home slots)
+    FastModulo mStrideModulo;   //!< By one less (double hashing strides)
+    FastModulo mBucketModulo;   //!< By the number of cuckoo buckets
 
     OAHTConfig mConfig;
-    mutable OAHTStats mStats;
+    OAHTStats mStats;
+    mutable ProbeCounter mProbes; //!< Probe accounting (Probes_ of GetStats()) and tracing
+    KeyStorage mKeys;             //!< Where the keys live (see OAHTInlineKeys)
+
+    char* mSnapshot;              //!< The mapped snapshot the table (or old table) lives in, or 0
+    size_t mSnapshotBytes;        //!< Size of the mapping
+    OAHTSnapshotWriter* mSnapshotWriter; //!< The background snapshot being written, or 0
+
+    FILE* mLog;                   //!< The op log, or 0
+    std::vector<char> mLogBuffer; //!< The log's stdio buffer
 };
 
 #include "OAHashTable.cpp"
@@ -0,0 +1,335 @@
+/**
+ * @file ShardedOAHashTable.cpp
+ * @author Adam Lonstein (adam.lonstein@digipen.com)
+ * @brief A hash table split into independent open-addressing hash tables (shards) for writers on
+ *        many threads. A remix of a key's hash picks its shard. Each shard has its own lock and
+ *        grows on its own, so writers on different shards never contend and one shard growing
+ *        doesn't block the others.
+ * @date 10-14-2026
+ */
+
+/**
+ * @brief Creates the shards. The initial table size is split between them.
+ * 
+ * @param Config - the config every shard is built from
+ * @param ShardCount - the number of shards (rounded up to a power of two)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ShardedOAHashTable(const OAHTConfig& Config, unsigned ShardCount) : mShards(0), mShardCount(GetNextPowerOfTwo(ShardCount)),
+                                                                                             mShardBits(0), mConfig(Config)
+{
+    while((1u << mShardBits) < mShardCount)
+        ++mShardBits;
+
+    // Each shard starts with its share of the table (2 keeps the stride of double hashing defined)
+    OAHTConfig shardConfig(Config);
+    shardConfig.InitialTableSize_ = Config.InitialTableSize_ / mShardCount;
+    if(shardConfig.InitialTableSize_ < 2)
+        shardConfig.InitialTableSize_ = 2;
+
+    mShards = new OAHTShard[mShardCount];
+
+    try
+    {
+        for(unsigned i = 0; i < mShardCount; ++i)
+            mShards[i].Table = new OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>(shardConfig);
+    }
+    catch(const std::bad_alloc&)
+    {
+        for(unsigned i = 0; i < mShardCount; ++i)
+            delete mShards[i].Table;
+
+        delete [] mShards;
+
+        throw OAHashTableException(OAHashTableException::E_NO_MEMORY, "Out of memory allocating shards.");
+    }
+}
+
+/**
+ * @brief Deletes every shard
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::~ShardedOAHashTable()
+{
+    for(unsigned i = 0; i < mShardCount; ++i)
+        delete mShards[i].Table;
+
+    delete [] mShards;
+}
+
+/**
+ * @brief Inserts a key and data into its shard
+ * 
+ * @param Key - the key to insert
+ * @param Data - the data to insert
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert(KeyType Key, const T& Data)
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    shard.Table->insert(Key, Data);
+}
+
+/**
+ * @brief Inserts a key and data into its shard, moving the data
+ * 
+ * @param Key - the key to insert
+ * @param Data - the data to insert
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert(KeyType Key, T&& Data)
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    shard.Table->insert(Key, std::move(Data));
+}
+
+/**
+ * @brief Inserts a key into its shard, constructing the data in its slot
+ * 
+ * @param Key - the key to insert
+ * @param args - the arguments of T's constructor
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename... Args>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::emplace(KeyType Key, Args&&... args)
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    shard.Table->emplace(Key, std::forward<Args>(args)...);
+}
+
+/**
+ * @brief Inserts a key and data into its shard, unless the key is already there
+ * 
+ * @param Key - the key to insert
+ * @param Data - the data to insert
+ * @return bool - false if the key was already in the table
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::try_insert(KeyType Key, const T& Data)
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    return shard.Table->try_insert(Key, Data);
+}
+
+/**
+ * @brief Inserts a key and data into its shard, or replaces the key's data
+ * 
+ * @param Key - the key to insert
+ * @param Data - the data to insert
+ * @return bool - true if the key was inserted, false if its data was replaced
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::insert_or_assign(KeyType Key, const T& Data)
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    return shard.Table->insert_or_assign(Key, Data);
+}
+
+/**
+ * @brief Reserves each shard its share of Count, plus room for the shards that get more than
+ *        their share (four standard deviations of a shard's count)
+ * 
+ * @param Count - the number of elements the table should hold
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::reserve(unsigned Count)
+{
+    double share = static_cast<double>(Count) / mShardCount;
+    unsigned shardCount = static_cast<unsigned>(std::ceil(share + 4 * std::sqrt(share)));
+
+    for(unsigned i = 0; i < mShardCount; ++i)
+    {
+        std::lock_guard<std::mutex> lock(mShards[i].Lock);
+
+        mShards[i].Table->reserve(shardCount);
+    }
+}
+
+/**
+ * @brief Shrinks each shard to fit its items, one shard at a time
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::shrink_to_fit()
+{
+    for(unsigned i = 0; i < mShardCount; ++i)
+    {
+        std::lock_guard<std::mutex> lock(mShards[i].Lock);
+
+        mShards[i].Table->shrink_to_fit();
+    }
+}
+
+/**
+ * @brief Removes a key and its data from its shard
+ * 
+ * @param Key - the key to remove
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::remove(KeyType Key)
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    shard.Table->remove(Key);
+}
+
+/**
+ * @brief Finds a key and copies its data out (the data can't be returned by reference
+ *        since another thread may remove it once the shard is unlocked)
+ * 
+ * @param Key - the key to find
+ * @param Data - set to the key's data if it was found
+ * @return bool - true if the key was found
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::find(KeyType Key, T& Data) const
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    const T* data = shard.Table->try_find(Key);
+
+    if(!data)
+        return false;
+
+    Data = *data;
+
+    return true;
+}
+
+/**
+ * @brief Returns true if the key is in the table
+ * 
+ * @param Key - the key to find
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+bool ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::contains(KeyType Key) const
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    return shard.Table->contains(Key);
+}
+
+/**
+ * @brief Finds a key and returns a copy of its data
+ * 
+ * @param Key - the key to find
+ * @return T - the key's data
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+T ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::find(KeyType Key) const
+{
+    OAHTShard& shard = mShards[ShardOf(Key)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    return shard.Table->find(Key);
+}
+
+/**
+ * @brief Clears every shard (one at a time)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::clear()
+{
+    for(unsigned i = 0; i < mShardCount; ++i)
+    {
+        std::lock_guard<std::mutex> lock(mShards[i].Lock);
+
+        mShards[i].Table->clear();
+    }
+}
+
+/**
+ * @brief Adds the stats of every shard together. Each shard is read under its lock, but
+ *        the shards are read one after another, so the total is not an atomic snapshot.
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+OAHTStats ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::GetStats() const
+{
+    OAHTStats stats;
+
+    stats.PrimaryHashFunc_ = OAHTStatsHashFunc(mConfig.PrimaryHashFunc_);
+    stats.SecondaryHashFunc_ = OAHTStatsHashFunc(mConfig.SecondaryHashFunc_);
+    stats.FullHashFunc_ = OAHTStatsHashFunc(mConfig.FullHashFunc_);
+
+    for(unsigned i = 0; i < mShardCount; ++i)
+    {
+        std::lock_guard<std::mutex> lock(mShards[i].Lock);
+        OAHTStats shardStats = mShards[i].Table->GetStats();
+
+        stats.Count_ += shardStats.Count_;
+        stats.TableSize_ += shardStats.TableSize_;
+        stats.Probes_ += shardStats.Probes_;
+        stats.Expansions_ += shardStats.Expansions_;
+        stats.Shrinks_ += shardStats.Shrinks_;
+        stats.Tombstones_ += shardStats.Tombstones_;
+    }
+
+    return stats;
+}
+
+/**
+ * @brief Calls a visitor with the key and data of every item, shard by shard
+ * 
+ * @param Visit - called as Visit(KeyType Key, const T& Data)
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+template<typename Visitor>
+void ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::for_each(Visitor Visit) const
+{
+    for(unsigned i = 0; i < mShardCount; ++i)
+    {
+        std::lock_guard<std::mutex> lock(mShards[i].Lock);
+
+        mShards[i].Table->for_each(Visit);
+    }
+}
+
+/**
+ * @brief Returns the number of shards
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ShardCount() const
+{
+    return mShardCount;
+}
+
+/**
+ * @brief Picks a key's shard from the top bits of its hash remixed. The shards index their
+ *        tables with the low bits (or the primary hash function) and take the control byte
+ *        fragments from the top bits of another remix, so the shard has to take its bits from
+ *        a multiplier of its own, or each shard would get only some of the fragments, and
+ *        more keys with the same one.
+ * 
+ * @param Key - the key
+ * @return unsigned - the index of the shard
+ */
+template<typename T, typename ProbeCounter, typename KeyStorage, typename Allocator, typename Policies>
+unsigned ShardedOAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::ShardOf(KeyType Key) const
+{
+    if(mShardBits == 0)
+        return 0;
+
+    unsigned fingerprint;
+
+    if(Policies::FIXED || mConfig.FullHashFunc_)
+    {
+        unsigned long long hash = Policies::FIXED ? typename Policies::Hash()(Key) : mConfig.FullHashFunc_(Key);
+        fingerprint = static_cast<unsigned>(hash ^ (hash >> 32));
+    }
+    else
+        fingerprint = KeyStorage::Fingerprint(Key);
+
+    return (fingerprint * 0x9E3779B9u) >> (32 - mShardBits);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file ShardedOAHashTable.h
+ * @author Adam Lonstein (adam.lonstein@digipen.com)
+ * @brief A hash table split into independent open-addressing hash tables (shards) for writers on
+ *        many threads. A remix of a key's hash picks its shard. Each shard has its own lock and
+ *        grows on its own, so writers on different shards never contend and one shard growing
+ *        doesn't block the others.
+ * @date 10-14-2026
+ */
+
+//---------------------------------------------------------------------------
+#ifndef SHARDEDOAHASHTABLEH
+#define SHARDEDOAHASHTABLEH
+//---------------------------------------------------------------------------
+#include <mutex>
+#include "OAHashTable.h"
+
+/*!
+Hash table definition (sharded, one lock per shard). Every shard is an
+OAHashTable built from the same config, with the initial table size split
+between the shards. ProbeCounter, KeyStorage, Allocator and Policies are
+passed on to the shards.
+*/
+template <typename T, typename ProbeCounter = OAHTProbeCounter, typename KeyStorage = OAHTInlineKeys, typename Allocator = OAHTHeapAllocator,
+          typename Policies = OAHTRuntimePolicy>
+class ShardedOAHashTable
+{
+  public:
+
+    typedef typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::FREEPROC FREEPROC;     //!< client-provided free proc (we own the data)
+    typedef typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::OAHTConfig OAHTConfig; //!< Same configuration as OAHashTable
+    typedef typename OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>::KeyType KeyType;       //!< Same keys as OAHashTable
+
+      // Constructor (ShardCount is rounded up to a power of two)
+    ShardedOAHashTable(const OAHTConfig& Config, unsigned ShardCount = 16);
+    ~ShardedOAHashTable(); // Destructor (no other thread may use the table)
+
+      // Insert a key/data pair into table. Throws an exception if the
+      // insertion is unsuccessful.
+    void insert(KeyType Key, const T& Data);
+    void insert(KeyType Key, T&& Data);
+
+      // Insert a key and data constructed in its slot from Args. Throws an
+      // exception if the insertion is unsuccessful.
+    template <typename... Args>
+    void emplace(KeyType Key, Args&&... args);
+
+      // Same as insert, but returns false instead of throwing E_DUPLICATE
+      // when the key is already in the table
+    bool try_insert(KeyType Key, const T& Data);
+
+      // Insert, or replace the data of a key already in the table (the free
+      // proc gets the old data). Returns true if the key was inserted.
+    bool insert_or_assign(KeyType Key, const T& Data);
+
+      // Grows every shard once so Count items spread over the shards fit
+      // without growing again
+    void reserve(unsigned Count);
+
+      // Shrinks every shard to fit the items it holds
+    void shrink_to_fit();
+
+      // Delete an item by key. Throws an exception if the key doesn't exist.
+    void remove(KeyType Key);
+
+      // Find and copy data by key. Returns false if not found.
+    bool find(KeyType Key, T& Data) const;
+
+      // Returns true if the key is in the table
+    bool contains(KeyType Key) const;
+
+      // Find and return a copy of the data by key. Throws an exception
+      // (E_ITEM_NOT_FOUND) if not found.
+    T find(KeyType Key) const;
+
+      // Removes all items from the table (Doesn't deallocate the shards)
+    void clear();
+
+      // Stats of all the shards added together
+    OAHTStats GetStats() const;
+
+      // Calls Visit(Key, Data) for every item, one shard at a time (each
+      // shard is locked while it is visited, so Visit must not use the table)
+    template <typename Visitor>
+    void for_each(Visitor Visit) const;
+
+      // The number of shards, and the shard a key belongs to
+    unsigned ShardCount() const;
+    unsigned ShardOf(KeyType Key) const;
+
+  private:
+      //! A shard and its lock, kept on their own cache line
+    struct OAHTShard
+    {
+      OAHTShard() : Table(0) {}
+
+      mutable std::mutex Lock;             //!< Serializes everything done to this shard
+      OAHashTable<T, ProbeCounter, KeyStorage, Allocator, Policies>* Table; //!< The shard's table
+      char Padding[64];                    //!< Keep shards off each other's cache lines
+    };
+
+    OAHTShard* mShards;   //!< The shards
+    unsigned mShardCount; //!< Number of shards (a power of two)
+    unsigned mShardBits;  //!< log2(mShardCount)
+
+    OAHTConfig mConfig;
+};
+
+#include "ShardedOAHashTable.cpp"
+
+#endif
@@ -5,10 +5,32 @@
 /* All rights reserved.                                  */
 /*********************************************************/
 /* Prime number array include file (auto-generated)      */
-/* This will find prime numbers up to about 16.8 million */
+/* The table runs to 4099; GetClosestPrime tests larger  */
+/* values, so it finds every prime up to 2^32            */
 /*********************************************************/
 
-#include <cmath>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SUPPORT_MMAP_FILES
+#endif
+
+#include "Support.h"
 
 const unsigned Primes[] = {
         2,    3,    5,    7,   11,   13,   17,   19,   23,   29, 
@@ -73,12 +95,72 @@ const unsigned Primes[] = {
 const unsigned PrimeCount = sizeof(Primes) / sizeof(*Primes);
 const unsigned MaxPrime = 4099;
 
+namespace
+{
+    // Base^Exponent % Modulus (Modulus < 2^32, so the products fit in 64 bits)
+  unsigned PowerMod(unsigned long long Base, unsigned Exponent, unsigned Modulus)
+  {
+    unsigned long long result = 1;
+    Base %= Modulus;
+    for (; Exponent; Exponent >>= 1)
+    {
+      if (Exponent & 1)
+        result = result * Base % Modulus;
+      Base = Base * Base % Modulus;
+    }
+    return static_cast<unsigned>(result);
+  }
+
+    // Primality of an odd Value past MaxPrime: trial division by the first
+    // primes of the table, then Miller-Rabin with the bases 2, 7 and 61,
+    // which has no false positives below 4,759,123,141
+  bool IsPrime(unsigned Value)
+  {
+    for (unsigned i = 1; i < 25; ++i)
+      if (Value % Primes[i] == 0)
+        return false;
+
+    unsigned odd = Value - 1, twos = 0;
+    while (!(odd & 1))
+    {
+      odd >>= 1;
+      ++twos;
+    }
+
+    const unsigned bases[] = {2, 7, 61};
+    for (unsigned i = 0; i < 3; ++i)
+    {
+      unsigned long long x = PowerMod(bases[i], odd, Value);
+      if (x == 1 || x == Value - 1)
+        continue;
+
+      unsigned squarings = 1;
+      for (; squarings < twos; ++squarings)
+      {
+        x = x * x % Value;
+        if (x == Value - 1)
+          break;
+      }
+
+      if (squarings == twos)
+        return false;
+    }
+
+    return true;
+  }
+}
+
 unsigned GetClosestPrime(unsigned Value)
 {
     // 1, 2, and 3 are prime.
   if (Value < 4)
     return Value;
 
+    // No prime fits past the largest 32-bit one
+  const unsigned LargestPrime = 4294967291u;
+  if (Value >= LargestPrime)
+    return LargestPrime;
+
     // Make sure our starting value is odd    
   unsigned prime;
   if (Value % 2)
@@ -107,37 +189,316 @@ unsigned GetClosestPrime(unsigned Value)
     return prime;
   }
 
+    // Past the table, test odd values until one is prime (primes are
+    // a few hundred apart at most below 2^32, and most candidates fail
+    // the trial division)
+  while (!IsPrime(prime))
+    prime += 2;
+
+  return prime;
+}
+
+
+
+unsigned GetNextPowerOfTwo(unsigned Value)
+{
+  if (Value > 0x80000000u)
+    return 0x80000000u;
+
+  unsigned power = 1;
+  while (power < Value)
+    power <<= 1;
+
+  return power;
+}
+
+namespace
+{
+    // The constants of wyhash
+  const unsigned long long HASH_SECRET0 = 0xa0761d6478bd642fULL;
+  const unsigned long long HASH_SECRET1 = 0xe7037ed1a0b428dbULL;
+  const unsigned long long HASH_SECRET2 = 0x8ebc6af09c88c6e3ULL;
+
+    // The 128-bit product of A and B, low half in A and high half in B
+  inline void Multiply(unsigned long long &A, unsigned long long &B)
+  {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 Product;
+    Product product = static_cast<Product>(A) * B;
+    A = static_cast<unsigned long long>(product);
+    B = static_cast<unsigned long long>(product >> 64);
+#else
+    unsigned long long ha = A >> 32, hb = B >> 32, la = A & 0xffffffffULL, lb = B & 0xffffffffULL;
+    unsigned long long high = ha * hb, middle0 = ha * lb, middle1 = hb * la, low = la * lb;
+    unsigned long long sum = low + (middle0 << 32), carry = sum < low;
+    A = sum + (middle1 << 32);
+    carry += A < sum;
+    B = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+  }
+
+  inline unsigned long long Mix(unsigned long long A, unsigned long long B)
+  {
+    Multiply(A, B);
+    return A ^ B;
+  }
 
-    /* the result is outside our prime number table range, use the
-       standard method for testing primality (do any of the primes up to
-       the root of the number divide it exactly?) and continue
-      incrementing the result by 2 until it is prime
-    */
-  if (prime <= MaxPrime * MaxPrime)
+    // Unaligned loads (memcpy compiles to a single move)
+  inline unsigned long long Load8(const char *Bytes)
   {
-    bool run = true;
-    while (run)
-    {
-      unsigned RootN = static_cast<unsigned>(std::sqrt((double)prime));
-      unsigned DivisorIndex = 1;
-      bool IsPrime = true;
-      while ((DivisorIndex < PrimeCount) && (RootN > Primes[DivisorIndex]))
-      {
-        if ( ((prime / Primes[DivisorIndex]) * Primes[DivisorIndex]) == prime )
-        {
-          IsPrime = false;
-          break;
-        }
-        DivisorIndex++;
-      }
-      if (IsPrime)
-        return prime;
-      
-      prime += 2;
+    unsigned long long value;
+    std::memcpy(&value, Bytes, sizeof(value));
+    return value;
+  }
 
-    }
+  inline unsigned long long Load4(const char *Bytes)
+  {
+    unsigned value;
+    std::memcpy(&value, Bytes, sizeof(value));
+    return value;
   }
-  return prime;
 }
 
+unsigned long long HashKey(const char *Key)
+{
+    // wyhash: the key is read 16 bytes at a time, and the last 16 (or the
+    // whole key, when it is shorter) with two overlapping loads. Nothing
+    // past the terminator is read.
+  std::size_t length = std::strlen(Key);
+  unsigned long long seed = Mix(HASH_SECRET0, HASH_SECRET1);
+  unsigned long long a, b;
+
+  if (length > 16)
+  {
+    const char *bytes = Key;
+    for (std::size_t left = length; left > 16; left -= 16, bytes += 16)
+      seed = Mix(Load8(bytes) ^ HASH_SECRET1, Load8(bytes + 8) ^ seed);
+
+    a = Load8(Key + length - 16);
+    b = Load8(Key + length - 8);
+  }
+  else if (length >= 8)
+  {
+    a = Load8(Key);
+    b = Load8(Key + length - 8);
+  }
+  else if (length >= 4)
+  {
+    a = Load4(Key);
+    b = Load4(Key + length - 4);
+  }
+  else if (length > 0)
+  {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(Key);
+    a = (static_cast<unsigned long long>(bytes[0]) << 16) | (static_cast<unsigned long long>(bytes[length >> 1]) << 8) | bytes[length - 1];
+    b = 0;
+  }
+  else
+    a = b = 0;
 
+  a ^= HASH_SECRET1;
+  b ^= seed;
+  Multiply(a, b);
+  return Mix(a ^ HASH_SECRET0 ^ length, b ^ HASH_SECRET1);
+}
+
+unsigned HashKeyPrimary(const char *Key, unsigned TableSize)
+{
+  return static_cast<unsigned>(HashKey(Key) % TableSize);
+}
+
+unsigned HashKeySecondary(const char *Key, unsigned TableSize)
+{
+    // Another mix of the same hash, so the stride doesn't follow the index
+  return static_cast<unsigned>(Mix(HashKey(Key) ^ HASH_SECRET2, HASH_SECRET1) % TableSize);
+}
+
+unsigned KeyFingerprint(const char *Key)
+{
+  unsigned long long hash = HashKey(Key);
+  return static_cast<unsigned>(hash ^ (hash >> 32));
+}
+
+void *AllocateAligned(std::size_t Bytes, std::size_t Alignment)
+{
+#if defined(_WIN32)
+  return _aligned_malloc(Bytes ? Bytes : 1, Alignment);
+#else
+  void *memory;
+  if (posix_memalign(&memory, Alignment < sizeof(void *) ? sizeof(void *) : Alignment, Bytes ? Bytes : 1))
+    return 0;
+  return memory;
+#endif
+}
+
+void FreeAligned(void *Memory)
+{
+#if defined(_WIN32)
+  _aligned_free(Memory);
+#else
+  free(Memory);
+#endif
+}
+
+namespace
+{
+  const std::size_t CACHE_LINE = 64;
+  const std::size_t HUGE_PAGE = 2 * 1024 * 1024; // Transparent hugepages (x86-64, most arm64)
+
+    // The granularity of a mapping, 0 when the allocation comes from the heap
+  std::size_t PageGranularity(std::size_t Bytes, std::size_t HugePageSize)
+  {
+#if defined(__linux__)
+    std::size_t page = HugePageSize > HUGE_PAGE ? HugePageSize : HUGE_PAGE;
+    return Bytes < page ? 0 : page;
+#else
+    (void)Bytes;
+    (void)HugePageSize;
+    return 0;
+#endif
+  }
+}
+
+void *AllocatePages(std::size_t Bytes, std::size_t HugePageSize, int NumaNode)
+{
+  std::size_t page = PageGranularity(Bytes, HugePageSize);
+  if (!page)
+    return AllocateAligned(Bytes, CACHE_LINE);
+
+#if defined(__linux__)
+  std::size_t length = (Bytes + page - 1) / page * page;
+  void *memory = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+    // Explicit hugepages only exist if the administrator reserved them
+  if (HugePageSize)
+  {
+    int log2 = 0;
+    while ((std::size_t(1) << log2) < HugePageSize)
+      ++log2;
+    memory = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2 << 26), -1, 0);
+  }
+#endif
+
+  if (memory == MAP_FAILED)
+  {
+      // Map an extra hugepage and trim it so the mapping starts on a hugepage boundary
+    char *mapped = static_cast<char *>(mmap(0, length + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (mapped == MAP_FAILED)
+      return 0;
+
+    std::size_t lead = (HUGE_PAGE - reinterpret_cast<std::size_t>(mapped) % HUGE_PAGE) % HUGE_PAGE;
+    if (lead)
+      munmap(mapped, lead);
+    munmap(mapped + lead + length, HUGE_PAGE - lead);
+
+    memory = mapped + lead;
+#if defined(MADV_HUGEPAGE)
+    madvise(memory, length, MADV_HUGEPAGE);
+#endif
+  }
+
+#if defined(SYS_mbind)
+    // Bind before anything touches the pages (MPOL_BIND is 2). Best effort, like the hugepages.
+  if (NumaNode >= 0 && NumaNode < static_cast<int>(8 * sizeof(unsigned long)))
+  {
+    unsigned long nodes = 1ul << NumaNode;
+    syscall(SYS_mbind, memory, length, 2, &nodes, 8 * sizeof(unsigned long), 0);
+  }
+#else
+  (void)NumaNode;
+#endif
+
+  return memory;
+#else
+  (void)NumaNode;
+  return 0;
+#endif
+}
+
+void FreePages(void *Memory, std::size_t Bytes, std::size_t HugePageSize)
+{
+  if (!Memory)
+    return;
+
+  std::size_t page = PageGranularity(Bytes, HugePageSize);
+  if (!page)
+  {
+    FreeAligned(Memory);
+    return;
+  }
+
+#if defined(__linux__)
+  munmap(Memory, (Bytes + page - 1) / page * page);
+#endif
+}
+
+void *MapFile(const char *Path, std::size_t &Bytes)
+{
+#if defined(SUPPORT_MMAP_FILES)
+  int file = open(Path, O_RDONLY);
+  if (file < 0)
+    return 0;
+
+  struct stat info;
+  if (fstat(file, &info) != 0 || info.st_size <= 0)
+  {
+    close(file);
+    return 0;
+  }
+
+  Bytes = static_cast<std::size_t>(info.st_size);
+  void *memory = mmap(0, Bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  close(file);
+
+  return memory == MAP_FAILED ? 0 : memory;
+#else
+  FILE *file = fopen(Path, "rb");
+  if (!file)
+    return 0;
+
+  long size = -1;
+  if (fseek(file, 0, SEEK_END) == 0)
+    size = ftell(file);
+
+  void *memory = size > 0 ? AllocateAligned(static_cast<std::size_t>(size), CACHE_LINE) : 0;
+  if (memory && (fseek(file, 0, SEEK_SET) != 0 || fread(memory, 1, static_cast<std::size_t>(size), file) != static_cast<std::size_t>(size)))
+  {
+    FreeAligned(memory);
+    memory = 0;
+  }
+
+  fclose(file);
+  Bytes = memory ? static_cast<std::size_t>(size) : 0;
+  return memory;
+#endif
+}
+
+void UnmapFile(void *Memory, std::size_t Bytes)
+{
+  if (!Memory)
+    return;
+
+#if defined(SUPPORT_MMAP_FILES)
+  munmap(Memory, Bytes);
+#else
+  (void)Bytes;
+  FreeAligned(Memory);
+#endif
+}
+
+bool WriteFileAt(FILE *File, unsigned long long Offset, const void *Bytes, std::size_t Count)
+{
+#if defined(_WIN32)
+  if (_fseeki64(File, static_cast<__int64>(Offset), SEEK_SET) != 0)
+    return false;
+#elif defined(SUPPORT_MMAP_FILES)
+  if (fseeko(File, static_cast<off_t>(Offset), SEEK_SET) != 0)
+    return false;
+#else
+  if (Offset > static_cast<unsigned long long>(LONG_MAX) || fseek(File, static_cast<long>(Offset), SEEK_SET) != 0)
+    return false;
+#endif
+
+  return fwrite(Bytes, 1, Count, File) == Count;
+}
@@ -2,7 +2,71 @@
 #ifndef SUPPORTH
 #define SUPPORTH
 //---------------------------------------------------------------------------
+#include <cstddef>
+#include <cstdio>
 
+  // Smallest prime >= Value, for any 32-bit Value (the largest 32-bit prime
+  // past it). Values below 4 are returned as they are.
 unsigned GetClosestPrime(unsigned Value);
 
+  // Smallest power of two that is >= Value (at most 2^31)
+unsigned GetNextPowerOfTwo(unsigned Value);
+
+  // Fast 64-bit hash of a string key (wyhash), the default FULLHASHFUNC.
+  // Reads the key 8 bytes at a time, never past its terminator.
+unsigned long long HashKey(const char *Key);
+
+  // HashKey as a HASHFUNC, and a secondary HASHFUNC for double hashing
+  // (a different mix of the same hash)
+unsigned HashKeyPrimary(const char *Key, unsigned TableSize);
+unsigned HashKeySecondary(const char *Key, unsigned TableSize);
+
+  // Table-size independent hash of a key, used for per-slot metadata
+  // (HashKey folded to 32 bits)
+unsigned KeyFingerprint(const char *Key);
+
+  // Remainders by a divisor fixed ahead of time, with multiplies instead of
+  // a divide (Lemire, Kaser and Kurz, "Faster Remainder by Direct
+  // Computation"). Exact for every 32-bit Value and nonzero Divisor.
+struct FastModulo
+{
+  explicit FastModulo(unsigned Divisor = 1) : Magic(~0ULL / Divisor + 1), Divisor(Divisor) {}
+
+  unsigned operator()(unsigned Value) const
+  {
+      // The high 64 bits of (Magic * Value, mod 2^64) * Divisor
+    unsigned long long fraction = Magic * Value;
+    unsigned long long low = (fraction & 0xffffffffULL) * Divisor;
+    return static_cast<unsigned>(((fraction >> 32) * Divisor + (low >> 32)) >> 32);
+  }
+
+  unsigned long long Magic; //!< 2^64 / Divisor, rounded up
+  unsigned Divisor;         //!< The divisor
+};
+
+  // Heap memory aligned to Alignment (a power of two), 0 if out of memory
+void *AllocateAligned(std::size_t Bytes, std::size_t Alignment);
+void FreeAligned(void *Memory);
+
+  // Memory mapped straight from the system for big tables. HugePageSize 0
+  // asks for transparent hugepages, 2MB or 1GB for explicit hugepages
+  // (transparent ones if none are reserved). NumaNode binds the pages to a
+  // node (-1 for any). Allocations smaller than a hugepage, and systems
+  // without these, get cache-line aligned heap memory. FreePages takes the
+  // Bytes and HugePageSize of the allocation. Returns 0 if out of memory.
+void *AllocatePages(std::size_t Bytes, std::size_t HugePageSize, int NumaNode);
+void FreePages(void *Memory, std::size_t Bytes, std::size_t HugePageSize);
+
+  // Maps a whole file copy-on-write: pages are shared with every process
+  // mapping the file until they are written to, and writes never reach the
+  // file. Sets Bytes to the file's size. Systems without mmap get a copy of
+  // the file in heap memory. Returns 0 if the file can't be read.
+void *MapFile(const char *Path, std::size_t &Bytes);
+void UnmapFile(void *Memory, std::size_t Bytes);
+
+  // Writes Count bytes at an offset into a file opened for binary writing
+  // (offsets past 2 GB too, where long is 32 bits). Returns false if the
+  // seek or the write fails.
+bool WriteFileAt(FILE *File, unsigned long long Offset, const void *Bytes, std::size_t Count);
+
 #endif
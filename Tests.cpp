@@ -0,0 +1,925 @@
+/**
+ * @file Tests.cpp
+ * @author Adam Lonstein (adam.lonstein@digipen.com)
+ * @brief Regression tests for the open-addressing hash table. Each test prints the checks that
+ *        failed, and the exit code is the number of tests that failed.
+ *
+ *        Build: g++ -std=c++11 -O2 Tests.cpp Support.cpp -o Tests
+ *        Run:   ./Tests
+ * @date 10-14-2026
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "OAHashTable.h"
+#include "ShardedOAHashTable.h"
+
+namespace
+{
+//! Counts and reports the failed checks of a test
+struct TestResult
+{
+    TestResult() : Failures(0) {}
+
+    void Check(bool Passed, const char* What)
+    {
+        if (!Passed)
+        {
+            std::printf("  failed: %s\n", What);
+            ++Failures;
+        }
+    }
+
+    unsigned Failures; //!< Checks that failed
+};
+
+std::string TestKey(const char* Prefix, unsigned Index)
+{
+    char key[MAX_KEYLEN];
+    std::snprintf(key, sizeof(key), "%s%u", Prefix, Index);
+    return key;
+}
+
+/**
+ * @brief Removes keys both from the grown table and from the old table of an incremental
+ *        resize while logging, then checks that replaying the log gives the same table
+ */
+void TestLogDuringIncrementalResize(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const char* path = "Tests.log";
+
+    Table::OAHTConfig config(11);
+    config.DeletionPolicy_ = MARK;
+    config.IncrementalResize_ = true;
+    config.ResizeStep_ = 1;
+
+    Table table(config);
+    table.OpenLog(path, false);
+
+    // Stop right after a grow starts, with nearly every key still in the old table
+    unsigned count = 0, size = table.GetStats().TableSize_;
+    while (table.GetStats().TableSize_ == size)
+    {
+        table.insert(TestKey("key", count).c_str(), count);
+        ++count;
+    }
+
+    for (unsigned i = 0; i < count; i += 2)
+        table.remove(TestKey("key", i).c_str());
+    table.CloseLog();
+
+    Table replayed(config);
+    replayed.ReplayLog(path);
+    std::remove(path);
+
+    Result.Check(replayed.GetStats().Count_ == table.GetStats().Count_, "the replayed table has the same count");
+    for (unsigned i = 0; i < count; ++i)
+        Result.Check(replayed.contains(TestKey("key", i).c_str()) == (i % 2 == 1), "the replayed table has the same keys");
+}
+
+/**
+ * @brief Destroys a table that is still logging, then checks that the log doesn't end with the
+ *        destructor's clear
+ */
+void TestDestroyWhileLogging(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const char* path = "Tests.log";
+    Table::OAHTConfig config(11);
+
+    {
+        Table table(config);
+        table.OpenLog(path, false);
+        for (unsigned i = 0; i < 100; ++i)
+            table.insert(TestKey("key", i).c_str(), i);
+    }
+
+    Table replayed(config);
+    replayed.ReplayLog(path);
+    std::remove(path);
+
+    Result.Check(replayed.GetStats().Count_ == 100, "the log has no clear");
+}
+
+/**
+ * @brief Keeps changing a table of many snapshot chunks while a background snapshot is written,
+ *        then checks that the snapshot has the table as it was when the snapshot began
+ */
+void TestBackgroundSnapshotWhileChanging(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const char* path = "Tests.snap";
+    const unsigned count = 100000;
+    Table::OAHTConfig config(11);
+
+    Table table(config);
+    for (unsigned i = 0; i < count; ++i)
+        table.insert(TestKey("key", i).c_str(), i);
+
+    table.BeginBackgroundSnapshot(path);
+    for (unsigned i = 0; i < count; i += 2)
+    {
+        table.remove(TestKey("key", i).c_str());
+        table.insert(TestKey("new", i).c_str(), i);
+        table.insert_or_assign(TestKey("key", i + 1).c_str(), 0);
+    }
+    Result.Check(table.BackgroundSnapshotDone(true), "the snapshot is written");
+
+    {
+        Table snapshot(config, path);
+        Result.Check(snapshot.GetStats().Count_ == count, "the snapshot has the count it began with");
+
+        bool same = true;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const unsigned* data = snapshot.try_find(TestKey("key", i).c_str());
+            same = same && data && *data == i && !snapshot.contains(TestKey("new", i).c_str());
+        }
+        Result.Check(same, "the snapshot has the keys and data it began with");
+    }
+
+    std::remove(path);
+}
+
+/**
+ * @brief Checks that the keys of one shard have every control byte fragment (the top 7 bits of
+ *        the fingerprint remixed), so the shard's tables don't see more keys with the same
+ *        fragment
+ */
+void TestShardFragmentSpread(TestResult& Result)
+{
+    typedef ShardedOAHashTable<unsigned> Table;
+    Table::OAHTConfig config(11);
+    Table table(config, 16);
+
+    bool fragments[128] = {false};
+    unsigned seen = 0;
+
+    for (unsigned i = 0; i < 100000; ++i)
+    {
+        std::string key = TestKey("key", i);
+        if (table.ShardOf(key.c_str()) != 0)
+            continue;
+
+        // The fingerprint of a table with a full-width hash function, and its fragment
+        unsigned long long hash = OAHTInlineKeys::FullHash(key.c_str());
+        unsigned fragment = (static_cast<unsigned>(hash ^ (hash >> 32)) * 0x85EBCA6Bu) >> 25;
+
+        if (!fragments[fragment])
+            ++seen;
+        fragments[fragment] = true;
+    }
+
+    Result.Check(seen == 128, "one shard has every fragment");
+}
+
+/**
+ * @brief Checks that the stats of a sharded table count the tombstones of every shard
+ */
+void TestShardedTombstones(TestResult& Result)
+{
+    typedef ShardedOAHashTable<unsigned> Table;
+    Table::OAHTConfig config(11);
+    config.DeletionPolicy_ = MARK;
+    Table table(config, 4);
+
+    for (unsigned i = 0; i < 1000; ++i)
+        table.insert(TestKey("key", i).c_str(), i);
+    for (unsigned i = 0; i < 100; ++i)
+        table.remove(TestKey("key", i).c_str());
+
+    Result.Check(table.GetStats().Tombstones_ == 100, "every removed key left a tombstone");
+}
+
+/**
+ * @brief Samples every other operation while assigning keys already in the table, then checks
+ *        that the find inside each assign isn't sampled on its own
+ */
+void TestTraceOutermostOperation(TestResult& Result)
+{
+    typedef OAHashTable<unsigned, OAHTSampledTracer<2, 256> > Table;
+    Table table(Table::OAHTConfig(11));
+
+    for (unsigned i = 0; i < 100; ++i)
+        table.insert(TestKey("key", i).c_str(), i);
+    for (unsigned i = 0; i < 100; ++i)
+        table.insert_or_assign(TestKey("key", i).c_str(), i + 1);
+
+    OAHTTraceRecord records[256];
+    size_t count = table.GetProbeCounter().Drain(records, 256);
+
+    bool inserts = true;
+    for (size_t i = 0; i < count; ++i)
+        inserts = inserts && records[i].Op == TRACE_INSERT;
+
+    Result.Check(count == 100, "one in two operations is sampled");
+    Result.Check(inserts, "every record is an insert");
+}
+
+//! HashKey as the hash of a fixed policy
+struct HashKeyFunctor
+{
+    unsigned long long operator()(const char* Key) const { return HashKey(Key); }
+};
+
+/**
+ * @brief Inserts keys, removes every third, then checks that the rest are still found and can
+ *        all be removed
+ */
+template <typename Table>
+void CheckRemoveEveryThird(TestResult& Result, const typename Table::OAHTConfig& Config)
+{
+    Table table(Config);
+
+    for (unsigned i = 0; i < 800; ++i)
+        table.insert(TestKey("key", i).c_str(), i);
+
+    unsigned removed = 0;
+    for (unsigned i = 0; i < 800; i += 3, ++removed)
+        table.remove(TestKey("key", i).c_str());
+
+    bool found = true;
+    for (unsigned i = 0; i < 800; ++i)
+        found = found && table.contains(TestKey("key", i).c_str()) == (i % 3 != 0);
+    Result.Check(found, "the keys left are found");
+    Result.Check(table.GetStats().Tombstones_ == removed, "every removal left a tombstone");
+
+    bool removable = true;
+    for (unsigned i = 0; i < 800; ++i)
+    {
+        if (i % 3 == 0)
+            continue;
+
+        try
+        {
+            table.remove(TestKey("key", i).c_str());
+        }
+        catch (const OAHashTableException&)
+        {
+            removable = false;
+        }
+    }
+    Result.Check(removable && table.GetStats().Count_ == 0, "the keys left can be removed");
+}
+
+/**
+ * @brief Removes keys with BACKWARD_SHIFT under double hashing (which marks them instead), from
+ *        the config and from a fixed policy
+ */
+void TestBackwardShiftUnderDoubleHashing(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    CheckRemoveEveryThird<Table>(Result, Table::OAHTConfig(1009, &HashKey, true, 0.9, 2.0, BACKWARD_SHIFT));
+
+    typedef OAHashTable<unsigned, OAHTProbeCounter, OAHTInlineKeys, OAHTHeapAllocator,
+                        OAHTFixedPolicy<DOUBLE_HASHING, BACKWARD_SHIFT, HashKeyFunctor> > FixedTable;
+    FixedTable::OAHTConfig config(1009);
+    config.MaxLoadFactor_ = 0.9;
+    CheckRemoveEveryThird<FixedTable>(Result, config);
+}
+
+//! The keys and data a table should hold
+typedef std::map<std::string, unsigned> Expected;
+
+/**
+ * @brief Whether a table holds exactly the keys and data of a map, looking up keys
+ *        "key0" to "key<Keys - 1>"
+ */
+template <typename Table>
+bool SameAsMap(const Table& table, const Expected& Map, unsigned Keys)
+{
+    bool same = table.GetStats().Count_ == Map.size();
+
+    for (unsigned i = 0; i < Keys && same; ++i)
+    {
+        std::string key = TestKey("key", i);
+        Expected::const_iterator it = Map.find(key);
+        const unsigned* data = table.try_find(key.c_str());
+
+        same = it == Map.end() ? data == 0 : data && *data == it->second;
+    }
+
+    return same;
+}
+
+/**
+ * @brief Runs the same random inserts, assigns and removes on a table of every deletion,
+ *        collision and layout policy and on a std::map, checking that they agree as they go
+ */
+void TestPolicyMatrix(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const OAHTDeletionPolicy deletions[] = {MARK, PACK, BACKWARD_SHIFT};
+    const char* deletionNames[] = {"MARK", "PACK", "BACKWARD_SHIFT"};
+    const char* collisionNames[] = {"linear probing", "double hashing", "ROBIN_HOOD", "CUCKOO"};
+    const OAHTLayoutPolicy layouts[] = {SLOT_STATE, CONTROL_BYTES};
+    const char* layoutNames[] = {"SLOT_STATE", "CONTROL_BYTES"};
+    const unsigned keys = 500;
+
+    for (unsigned d = 0; d < 3; ++d)
+        for (unsigned c = 0; c < 4; ++c)
+            for (unsigned l = 0; l < 2; ++l)
+            {
+                Table::OAHTConfig config(11);
+                config.MaxLoadFactor_ = 0.8;
+                config.DeletionPolicy_ = deletions[d];
+                config.DoubleHashing_ = c == 1;
+                config.CollisionPolicy_ = c == 2 ? ROBIN_HOOD : c == 3 ? CUCKOO : PROBE_SEQUENCE;
+                config.LayoutPolicy_ = layouts[l];
+
+                Table table(config);
+                Expected map;
+                bool same = true;
+                unsigned random = 12345;
+
+                for (unsigned op = 1; op <= 20000 && same; ++op)
+                {
+                    random = random * 1103515245u + 12345u;
+                    unsigned index = (random >> 8) % keys;
+                    std::string key = TestKey("key", index);
+                    bool present = map.count(key) != 0;
+
+                    switch ((random >> 4) % 4)
+                    {
+                        case 0:
+                        case 1:
+                            same = table.try_insert(key.c_str(), op) != present;
+                            if (!present)
+                                map[key] = op;
+                            break;
+                        case 2:
+                            same = table.insert_or_assign(key.c_str(), op) != present;
+                            map[key] = op;
+                            break;
+                        default:
+                            if (present)
+                            {
+                                table.remove(key.c_str());
+                                map.erase(key);
+                            }
+                            break;
+                    }
+
+                    if (op % 1000 == 0)
+                        same = same && SameAsMap(table, map, keys);
+                }
+
+                if (!same)
+                    std::printf("  %s, %s, %s:\n", deletionNames[d], collisionNames[c], layoutNames[l]);
+                Result.Check(same, "the table agrees with a std::map");
+            }
+}
+
+/**
+ * @brief Inserts keys while small steps of an incremental resize move them to the grown
+ *        tables, removes and re-inserts half of them, checking that every key stays found
+ */
+void TestIncrementalResizeRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 2000;
+
+    Table::OAHTConfig config(11);
+    config.IncrementalResize_ = true;
+    config.ResizeStep_ = 2;
+
+    Table table(config);
+    Expected map;
+    bool same = true;
+
+    for (unsigned i = 0; i < keys; ++i)
+    {
+        table.insert(TestKey("key", i).c_str(), i);
+        map[TestKey("key", i)] = i;
+        if (i % 50 == 0)
+            same = same && SameAsMap(table, map, keys);
+    }
+    Result.Check(same && SameAsMap(table, map, keys), "every key is found while the table grows");
+    Result.Check(table.GetStats().Expansions_ > 5, "the table grew");
+
+    for (unsigned i = 0; i < keys; i += 2)
+    {
+        table.remove(TestKey("key", i).c_str());
+        map.erase(TestKey("key", i));
+    }
+    Result.Check(SameAsMap(table, map, keys), "the removed keys are gone");
+
+    for (unsigned i = 0; i < keys; i += 2)
+    {
+        table.insert(TestKey("key", i).c_str(), i + keys);
+        map[TestKey("key", i)] = i + keys;
+    }
+    Result.Check(SameAsMap(table, map, keys), "the re-inserted keys have their new data");
+}
+
+/**
+ * @brief Removes keys under MARK and re-inserts them, checking that the inserts reuse the
+ *        tombstones, then removes them again with a MaxTombstoneFactor_, checking that the
+ *        tombstones are purged without growing the table
+ */
+void TestTombstoneRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 100;
+
+    Table::OAHTConfig config(211);
+    config.DeletionPolicy_ = MARK;
+
+    for (unsigned purge = 0; purge < 2; ++purge)
+    {
+        config.MaxTombstoneFactor_ = purge ? 0.1 : 0;
+
+        Table table(config);
+        Expected map;
+
+        for (unsigned i = 0; i < keys; ++i)
+        {
+            table.insert(TestKey("key", i).c_str(), i);
+            map[TestKey("key", i)] = i;
+        }
+
+        for (unsigned i = 0; i < keys; i += 2)
+        {
+            table.remove(TestKey("key", i).c_str());
+            map.erase(TestKey("key", i));
+        }
+        Result.Check(SameAsMap(table, map, keys), "the removed keys are gone");
+
+        if (purge)
+        {
+            Result.Check(table.GetStats().Tombstones_ <= 211 / 10, "the tombstones are purged");
+            Result.Check(table.GetStats().TableSize_ == 211, "purging keeps the table size");
+            continue;
+        }
+        Result.Check(table.GetStats().Tombstones_ == keys / 2, "every removal left a tombstone");
+
+        for (unsigned i = 0; i < keys; i += 2)
+        {
+            table.insert(TestKey("key", i).c_str(), i + keys);
+            map[TestKey("key", i)] = i + keys;
+        }
+        Result.Check(SameAsMap(table, map, keys), "the re-inserted keys have their new data");
+        Result.Check(table.GetStats().Tombstones_ == 0, "the inserts reuse the tombstones");
+        Result.Check(table.GetStats().Expansions_ == 0, "the table never grew");
+    }
+}
+
+/**
+ * @brief Fills a cuckoo table to a high load factor, removes and re-inserts half of the keys,
+ *        checking the keys and that a miss never looks past the two buckets
+ */
+void TestCuckooRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 5000;
+
+    Table::OAHTConfig config(11);
+    config.MaxLoadFactor_ = 0.9;
+    config.CollisionPolicy_ = CUCKOO;
+
+    Table table(config);
+    Expected map;
+
+    for (unsigned i = 0; i < keys; ++i)
+    {
+        table.insert(TestKey("key", i).c_str(), i);
+        map[TestKey("key", i)] = i;
+    }
+    Result.Check(SameAsMap(table, map, keys), "every key is found");
+
+    unsigned probes = table.GetStats().Probes_;
+    for (unsigned i = 0; i < 1000; ++i)
+        table.contains(TestKey("miss", i).c_str());
+    Result.Check(table.GetStats().Probes_ - probes <= 1000 * 8, "a miss looks at two 4-way buckets at most");
+
+    for (unsigned i = 0; i < keys; i += 2)
+    {
+        table.remove(TestKey("key", i).c_str());
+        map.erase(TestKey("key", i));
+    }
+    Result.Check(SameAsMap(table, map, keys), "the removed keys are gone");
+
+    for (unsigned i = 0; i < keys; i += 2)
+    {
+        table.insert(TestKey("key", i).c_str(), i + keys);
+        map[TestKey("key", i)] = i + keys;
+    }
+    Result.Check(SameAsMap(table, map, keys), "the re-inserted keys have their new data");
+}
+
+/**
+ * @brief Looks up hits and misses with find_batch, on a plain table and on a control-byte table
+ *        in the middle of an incremental resize, checking each result against try_find
+ */
+void TestFindBatchRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 1000;
+
+    for (unsigned layout = 0; layout < 2; ++layout)
+    {
+        Table::OAHTConfig config(11);
+        if (layout)
+        {
+            config.LayoutPolicy_ = CONTROL_BYTES;
+            config.IncrementalResize_ = true;
+            config.ResizeStep_ = 1;
+        }
+
+        Table table(config);
+        for (unsigned i = 0; i < keys; i += 2)
+            table.insert(TestKey("key", i).c_str(), i);
+
+        // Every other key is a miss
+        std::string names[keys];
+        const char* batch[keys];
+        const unsigned* data[keys];
+        for (unsigned i = 0; i < keys; ++i)
+        {
+            names[i] = TestKey("key", i);
+            batch[i] = names[i].c_str();
+        }
+
+        size_t found = table.find_batch(batch, keys, data);
+
+        bool same = true;
+        for (unsigned i = 0; i < keys; ++i)
+            same = same && data[i] == table.try_find(batch[i]) && (i % 2 == 0 ? data[i] && *data[i] == i : !data[i]);
+
+        Result.Check(found == keys / 2, "find_batch finds the keys in the table");
+        Result.Check(same, "find_batch gives the data of try_find");
+    }
+}
+
+/**
+ * @brief Reserves room for keys and inserts them, checking that only the reserve grows the
+ *        table, then inserts them again with insert_bulk (from arrays and from a range) along
+ *        with new keys, checking that only the new keys are inserted
+ */
+void TestInsertBulkRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 1000;
+
+    Table table(Table::OAHTConfig(11));
+    Expected map;
+
+    table.reserve(keys);
+    Result.Check(table.GetStats().Expansions_ == 1, "reserve grows the table once");
+
+    unsigned size = table.GetStats().TableSize_;
+    for (unsigned i = 0; i < keys; ++i)
+    {
+        table.insert(TestKey("key", i).c_str(), i);
+        map[TestKey("key", i)] = i;
+    }
+    Result.Check(table.GetStats().TableSize_ == size, "the reserved keys fit without growing");
+
+    // The second half of each batch is new
+    std::string names[keys];
+    const char* batch[keys];
+    unsigned data[keys];
+    for (unsigned i = 0; i < keys; ++i)
+    {
+        names[i] = TestKey("key", i + keys / 2);
+        batch[i] = names[i].c_str();
+        data[i] = i + keys / 2;
+        map.insert(Expected::value_type(names[i], data[i]));
+    }
+    Result.Check(table.insert_bulk(batch, data, keys) == keys / 2, "insert_bulk skips the keys in the table");
+
+    std::vector<std::pair<const char*, unsigned> > range;
+    for (unsigned i = 0; i < keys; ++i)
+    {
+        names[i] = TestKey("key", i + keys);
+        range.push_back(std::make_pair(names[i].c_str(), i + keys));
+        map.insert(Expected::value_type(names[i], i + keys));
+    }
+    Result.Check(table.insert_bulk(range.begin(), range.end()) == keys / 2, "insert_bulk of a range skips the keys in the table");
+    Result.Check(SameAsMap(table, map, 2 * keys), "every key has its first data");
+}
+
+/**
+ * @brief Saves snapshots of a slot-state and a control-byte table and maps them back, checking
+ *        the keys, that changing a mapped table leaves the file alone, and that a config with
+ *        another layout is refused
+ */
+void TestSnapshotRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const char* path = "Tests.snap";
+    const unsigned keys = 1000;
+
+    for (unsigned layout = 0; layout < 2; ++layout)
+    {
+        Table::OAHTConfig config(11);
+        config.LayoutPolicy_ = layout ? CONTROL_BYTES : SLOT_STATE;
+
+        Expected map;
+        {
+            Table table(config);
+            for (unsigned i = 0; i < keys; ++i)
+            {
+                table.insert(TestKey("key", i).c_str(), i);
+                map[TestKey("key", i)] = i;
+            }
+            for (unsigned i = 0; i < keys; i += 3)
+            {
+                table.remove(TestKey("key", i).c_str());
+                map.erase(TestKey("key", i));
+            }
+            table.SaveSnapshot(path);
+        }
+
+        {
+            Table mapped(config, path);
+            Result.Check(SameAsMap(mapped, map, keys), "the mapped table has the saved keys");
+
+            // Copy-on-write: the changes stay in this process
+            for (unsigned i = 0; i < keys; ++i)
+                mapped.insert_or_assign(TestKey("key", i).c_str(), 0);
+        }
+
+        {
+            Table mapped(config, path);
+            Result.Check(SameAsMap(mapped, map, keys), "changing a mapped table leaves the file alone");
+        }
+
+        Table::OAHTConfig other = config;
+        other.LayoutPolicy_ = layout ? SLOT_STATE : CONTROL_BYTES;
+        bool refused = false;
+        try
+        {
+            Table mapped(other, path);
+        }
+        catch (const OAHashTableException& e)
+        {
+            refused = e.code() == OAHashTableException::E_SNAPSHOT;
+        }
+        Result.Check(refused, "a snapshot of another layout is refused");
+    }
+
+    std::remove(path);
+}
+
+//! Collects the items for_each visits, in order
+struct CollectItems
+{
+    explicit CollectItems(std::vector<std::pair<std::string, unsigned> >& Items) : Items(Items) {}
+
+    void operator()(const char* Key, unsigned Data) const { Items.push_back(std::make_pair(std::string(Key), Data)); }
+
+    std::vector<std::pair<std::string, unsigned> >& Items; //!< The items visited
+};
+
+/**
+ * @brief Walks tables with tombstones, with control bytes, and in the middle of an incremental
+ *        resize with the iterators, checking that they visit every item once and in the order
+ *        of for_each
+ */
+void TestIteratorRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 1000;
+
+    for (unsigned variant = 0; variant < 3; ++variant)
+    {
+        Table::OAHTConfig config(11);
+        config.DeletionPolicy_ = variant == 0 ? MARK : PACK;
+        config.LayoutPolicy_ = variant == 1 ? CONTROL_BYTES : SLOT_STATE;
+        config.IncrementalResize_ = variant == 2;
+        config.ResizeStep_ = 1;
+
+        Table table(config);
+        Expected map;
+        for (unsigned i = 0; i < keys; ++i)
+        {
+            table.insert(TestKey("key", i).c_str(), i);
+            map[TestKey("key", i)] = i;
+        }
+        for (unsigned i = 0; i < keys; i += 3)
+        {
+            table.remove(TestKey("key", i).c_str());
+            map.erase(TestKey("key", i));
+        }
+
+        std::vector<std::pair<std::string, unsigned> > visited;
+        table.for_each(CollectItems(visited));
+
+        Expected walked;
+        bool ordered = true;
+        unsigned count = 0;
+        for (Table::const_iterator it = table.begin(); it != table.end(); ++it, ++count)
+        {
+            walked[it.key()] = it.data();
+            ordered = ordered && count < visited.size() && visited[count].first == it.key() && visited[count].second == it.data();
+        }
+
+        Result.Check(count == map.size() && walked == map, "the iterators visit every item once");
+        Result.Check(ordered && count == visited.size(), "the iterators walk in the order of for_each");
+    }
+}
+
+/**
+ * @brief Grows tables and removes most of their keys, shrinking one with shrink_to_fit and the
+ *        other on its own with a MinLoadFactor_, then grows them back, checking the keys and
+ *        sizes along the way
+ */
+void TestShrinkRoundTrip(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 5000, kept = 100;
+
+    for (unsigned automatic = 0; automatic < 2; ++automatic)
+    {
+        Table::OAHTConfig config(11);
+        config.MinLoadFactor_ = automatic ? 0.1 : 0;
+
+        Table table(config);
+        Expected map;
+        for (unsigned i = 0; i < keys; ++i)
+        {
+            table.insert(TestKey("key", i).c_str(), i);
+            map[TestKey("key", i)] = i;
+        }
+
+        unsigned grown = table.GetStats().TableSize_;
+        for (unsigned i = kept; i < keys; ++i)
+        {
+            table.remove(TestKey("key", i).c_str());
+            map.erase(TestKey("key", i));
+        }
+        if (!automatic)
+        {
+            Result.Check(table.GetStats().Shrinks_ == 0, "removes don't shrink without a MinLoadFactor_");
+            table.shrink_to_fit();
+        }
+
+        unsigned shrunk = table.GetStats().TableSize_;
+        Result.Check(table.GetStats().Shrinks_ > 0 && shrunk < grown / 10, "the table shrank");
+        Result.Check(kept <= shrunk * config.MaxLoadFactor_, "the shrunk table is under the max load factor");
+        Result.Check(SameAsMap(table, map, keys), "the shrunk table has the kept keys");
+
+        for (unsigned i = kept; i < keys; ++i)
+        {
+            table.insert(TestKey("key", i).c_str(), i + keys);
+            map[TestKey("key", i)] = i + keys;
+        }
+        Result.Check(table.GetStats().TableSize_ > shrunk, "the table grew back");
+        Result.Check(SameAsMap(table, map, keys), "the grown table has every key");
+    }
+}
+
+/**
+ * @brief Grows tables past the size a rehash is spread over threads at, and the same tables
+ *        with a serial rehash, checking that they end up with the same items (and, under
+ *        linear probing, the same probe total)
+ */
+void TestParallelRehashMatchesSerial(TestResult& Result)
+{
+    typedef OAHashTable<unsigned> Table;
+    const unsigned keys = 150000;
+    const char* names[] = {"linear probing", "double hashing"};
+
+    Expected map;
+    for (unsigned i = 0; i < keys; ++i)
+        map[TestKey("key", i)] = i;
+
+    for (unsigned probing = 0; probing < 2; ++probing)
+        for (unsigned layout = 0; layout < 2; ++layout)
+        {
+            Table::OAHTConfig config(11);
+            config.DoubleHashing_ = probing == 1;
+            config.LayoutPolicy_ = layout ? CONTROL_BYTES : SLOT_STATE;
+
+            Table serial(config);
+            config.RehashThreads_ = 4;
+            Table parallel(config);
+
+            for (unsigned i = 0; i < keys; ++i)
+            {
+                serial.insert(TestKey("key", i).c_str(), i);
+                parallel.insert(TestKey("key", i).c_str(), i);
+            }
+
+            bool same = SameAsMap(serial, map, keys) && SameAsMap(parallel, map, keys);
+            if (!probing)
+                same = same && parallel.GetStats().Probes_ == serial.GetStats().Probes_;
+
+            if (!same)
+                std::printf("  %s, %s:\n", names[probing], layout ? "CONTROL_BYTES" : "SLOT_STATE");
+            Result.Check(same, "the parallel rehash gives the serial rehash's items");
+        }
+}
+
+/**
+ * @brief Fills a table of the runtime policy and the same table of a fixed policy, whose slots
+ *        keep no probes, checking that they report the same analytics (walking each key's
+ *        probe sequence instead)
+ */
+template <OAHTProbing Probing, OAHTDeletionPolicy Deletion, bool CacheHashes>
+void CheckFixedAnalytics(TestResult& Result)
+{
+    typedef OAHashTable<unsigned, OAHTProbeCounter, OAHTArenaKeys> Table;
+    typedef OAHashTable<unsigned, OAHTProbeCounter, OAHTArenaKeys, OAHTHeapAllocator,
+                        OAHTFixedPolicy<Probing, Deletion, HashKeyFunctor, CacheHashes> > FixedTable;
+    const unsigned keys = 2000;
+
+    Table::OAHTConfig config(11);
+    config.DoubleHashing_ = Probing == DOUBLE_HASHING;
+    config.DeletionPolicy_ = Deletion;
+    config.CacheHashes_ = CacheHashes;
+    Table table(config);
+    FixedTable fixed(typename FixedTable::OAHTConfig(11));
+
+    for (unsigned i = 0; i < keys; ++i)
+    {
+        table.insert(TestKey("key", i).c_str(), i);
+        fixed.insert(TestKey("key", i).c_str(), i);
+    }
+    for (unsigned i = 0; i < keys; i += 3)
+    {
+        table.remove(TestKey("key", i).c_str());
+        fixed.remove(TestKey("key", i).c_str());
+    }
+
+    OAHTAnalytics expected = table.GetAnalytics(), analytics = fixed.GetAnalytics();
+    Result.Check(analytics.SuccessfulProbes_ == expected.SuccessfulProbes_ && analytics.LongestProbe_ == expected.LongestProbe_,
+                 "the fixed policy reports the same probes");
+    Result.Check(fixed.GetStats().Probes_ == table.GetStats().Probes_, "the fixed policy probes the same slots");
+}
+
+/**
+ * @brief Checks that the slots of a fixed policy leave out the probes (unless backward shifts
+ *        need them) and the hash (unless it's cached), and still report the analytics of the
+ *        runtime policy
+ */
+void TestFixedPolicyLeanSlots(TestResult& Result)
+{
+    typedef OAHashTable<unsigned, OAHTProbeCounter, OAHTArenaKeys> Table;
+    typedef OAHashTable<unsigned, OAHTProbeCounter, OAHTArenaKeys, OAHTHeapAllocator,
+                        OAHTFixedPolicy<LINEAR_PROBING, PACK, HashKeyFunctor> > FixedTable;
+    typedef OAHashTable<unsigned, OAHTProbeCounter, OAHTArenaKeys, OAHTHeapAllocator,
+                        OAHTFixedPolicy<LINEAR_PROBING, PACK, HashKeyFunctor, true> > CachedTable;
+
+    Result.Check(sizeof(FixedTable::OAHTSlot) == sizeof(Table::OAHTSlot) - sizeof(int) - sizeof(unsigned), "fixed slots keep no probes or hash");
+    Result.Check(sizeof(CachedTable::OAHTSlot) == sizeof(FixedTable::OAHTSlot) + sizeof(unsigned), "cached fixed slots keep the hash");
+    Result.Check(OAHTFixedPolicy<LINEAR_PROBING, BACKWARD_SHIFT, HashKeyFunctor>::SLOT_PROBES, "backward shift slots keep the probes");
+
+    CheckFixedAnalytics<LINEAR_PROBING, PACK, false>(Result);
+    CheckFixedAnalytics<LINEAR_PROBING, BACKWARD_SHIFT, false>(Result);
+    CheckFixedAnalytics<DOUBLE_HASHING, MARK, false>(Result);
+    CheckFixedAnalytics<LINEAR_PROBING, MARK, true>(Result);
+}
+
+//! A test and its name in the report
+struct Test
+{
+    const char* Name;
+    void (*Run)(TestResult&);
+};
+
+const Test TESTS[] =
+{
+    {"log during incremental resize", TestLogDuringIncrementalResize},
+    {"destroy while logging", TestDestroyWhileLogging},
+    {"background snapshot while changing", TestBackgroundSnapshotWhileChanging},
+    {"shard fragment spread", TestShardFragmentSpread},
+    {"sharded tombstones", TestShardedTombstones},
+    {"trace outermost operation", TestTraceOutermostOperation},
+    {"backward shift under double hashing", TestBackwardShiftUnderDoubleHashing},
+    {"policy matrix", TestPolicyMatrix},
+    {"incremental resize round trip", TestIncrementalResizeRoundTrip},
+    {"tombstone round trip", TestTombstoneRoundTrip},
+    {"cuckoo round trip", TestCuckooRoundTrip},
+    {"find_batch round trip", TestFindBatchRoundTrip},
+    {"insert_bulk round trip", TestInsertBulkRoundTrip},
+    {"snapshot round trip", TestSnapshotRoundTrip},
+    {"iterator round trip", TestIteratorRoundTrip},
+    {"shrink round trip", TestShrinkRoundTrip},
+    {"parallel rehash matches serial", TestParallelRehashMatchesSerial},
+    {"fixed policy lean slots", TestFixedPolicyLeanSlots},
+};
+}
+
+int main()
+{
+    int failed = 0;
+
+    for (unsigned i = 0; i < sizeof(TESTS) / sizeof(*TESTS); ++i)
+    {
+        TestResult result;
+        TESTS[i].Run(result);
+
+        std::printf("%-40s %s\n", TESTS[i].Name, result.Failures ? "FAILED" : "ok");
+        if (result.Failures)
+            ++failed;
+    }
+
+    return failed;
+}